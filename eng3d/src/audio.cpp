@@ -32,6 +32,7 @@
 #include "eng3d/utils.hpp"
 #include "eng3d/log.hpp"
 #include "eng3d/state.hpp"
+#include "eng3d/io.hpp"
 extern "C" {
 #include "stb_vorbis.c"
 }
@@ -124,4 +125,17 @@ const std::shared_ptr<Eng3D::Audio> Eng3D::AudioManager::load(const std::string&
     sounds[path] = std::make_shared<Eng3D::Audio>(path);
     Eng3D::Log::debug("audio", Eng3D::translate_format("Loaded and cached sound %s", path.c_str()));
     return sounds[path];
+}
+
+/// @brief Loads the sound of an asset, assets with the same contents share the sound
+const std::shared_ptr<Eng3D::Audio> Eng3D::AudioManager::load(std::shared_ptr<Eng3D::IO::Asset::Base> asset) {
+    if(asset.get() == nullptr) return this->load("");
+    const auto path = asset->get_abs_path();
+    if(!asset->content_hash) return this->load(path);
+    auto it = sounds_by_content.find(asset->content_hash);
+    if(it != sounds_by_content.cend()) {
+        Eng3D::Log::debug("audio", Eng3D::translate_format("Sound %s has the same contents as a loaded one, sharing it", path.c_str()));
+        return sounds[path] = (*it).second;
+    }
+    return sounds_by_content[asset->content_hash] = this->load(path);
 }
\ No newline at end of file
@@ -33,6 +33,12 @@
 #include <memory>
 
 struct pa_simple;
+namespace Eng3D::IO {
+    namespace Asset {
+        class Base;
+    };
+};
+
 namespace Eng3D {
     class State;
 
@@ -58,6 +64,7 @@ namespace Eng3D {
     class AudioManager {
         static void mixaudio(void* userdata, uint8_t* stream, int len);
         std::map<std::string, std::shared_ptr<Eng3D::Audio>> sounds;
+        std::map<uint64_t, std::shared_ptr<Eng3D::Audio>> sounds_by_content; // Keyed by the hash of the file
         Eng3D::State& s;
         int audio_dev_id = 0;
     public:
@@ -65,6 +72,7 @@ namespace Eng3D {
         AudioManager(Eng3D::State& s);
         ~AudioManager();
         const std::shared_ptr<Audio> load(const std::string& path);
+        const std::shared_ptr<Audio> load(std::shared_ptr<Eng3D::IO::Asset::Base> asset);
 
         // Queue of sounds/music
         std::mutex sound_lock;
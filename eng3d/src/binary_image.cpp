@@ -81,6 +81,18 @@ void Eng3D::BinaryImage::from_file(const Eng3D::IO::Path& path) {
     std::free(c_buffer);
 }
 
+/// @brief Reads only the dimensions of an image file, the pixels are not decoded so this is
+/// cheap enough to be done before handing the full decode to another thread
+/// @param path Path of the image file
+void Eng3D::BinaryImage::read_header(const Eng3D::IO::Path& path) {
+    int i_width, i_height, i_channels;
+    if(!stbi_info(path.str.c_str(), &i_width, &i_height, &i_channels))
+        CXX_THROW(BinaryImageException, path.str, stbi_failure_reason());
+    width = static_cast<size_t>(i_width);
+    height = static_cast<size_t>(i_height);
+    bpp = 32;
+}
+
 void Eng3D::BinaryImage::to_file(const std::string& filename) {
     int channel_count = bpp == 32 ? 4 : bpp == 16 ? 2 : bpp == 8 ? 1 : 0;
     int stride = channel_count * width;
@@ -59,6 +59,7 @@ namespace Eng3D {
         BinaryImage& operator=(const BinaryImage&) = delete;
         virtual ~BinaryImage() = default;
         virtual void from_file(const Eng3D::IO::Path& path);
+        void read_header(const Eng3D::IO::Path& path);
         virtual void to_file(const std::string& filename);
 
         /// @brief Obtains a pixel from the binary image
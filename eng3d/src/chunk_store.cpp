@@ -0,0 +1,330 @@
+// Eng3D - General purpouse game engine
+// Copyright (C) 2021, Eng3D contributors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+// Name:
+//      chunk_store.cpp
+//
+// Abstract:
+//      Does some important stuff.
+// ----------------------------------------------------------------------------
+
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <set>
+#include <tbb/parallel_for.h>
+#ifdef E3D_TARGET_UNIX
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+#include "eng3d/chunk_store.hpp"
+#include "eng3d/codec.hpp"
+#include "eng3d/hash.hpp"
+#include "eng3d/log.hpp"
+#include "eng3d/utils.hpp"
+
+/// @brief Random values for the gear rolling hash, generated with splitmix64
+static constexpr auto gear_table = []() {
+    std::array<uint64_t, 256> table{};
+    uint64_t x = 0x2545F4914F6CDD1DULL;
+    for(auto& e : table) {
+        x += 0x9E3779B97F4A7C15ULL;
+        uint64_t z = x;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        e = z ^ (z >> 31);
+    }
+    return table;
+}();
+
+constexpr std::string_view manifest_section_name = "manifest";
+using unique_file = std::unique_ptr<FILE, decltype(&std::fclose)>;
+
+/// @brief Flushes a written file onto the disk
+static bool sync_file(FILE* fp) {
+    if(std::fflush(fp) != 0) return false;
+#ifdef E3D_TARGET_UNIX
+    if(::fsync(::fileno(fp)) != 0) return false;
+#endif
+    return true;
+}
+
+/// @brief Flushes the entries of a directory onto the disk, so files renamed into it
+/// survive a crash
+static void sync_directory(const std::string& dir) {
+#ifdef E3D_TARGET_UNIX
+    const int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if(fd < 0 || ::fsync(fd) != 0) {
+        if(fd >= 0) ::close(fd);
+        CXX_THROW(SerializerException, translate_format("Can't sync directory %s", dir.c_str()));
+    }
+    ::close(fd);
+#else
+    (void)dir;
+#endif
+}
+
+/// @brief Unique suffix for temporary files, so concurrent saves writing the same chunk
+/// don't write onto the same file
+static std::string get_tmp_suffix() {
+    static std::atomic<size_t> n_tmp_files = 0;
+#ifdef E3D_TARGET_UNIX
+    return string_format(".%ld.%zu.tmp", static_cast<long>(::getpid()), n_tmp_files++);
+#else
+    return string_format(".%zu.tmp", n_tmp_files++);
+#endif
+}
+
+/// @brief (De)-serializes the manifest of a save: the encoding settings and string table of
+/// the archive, it's size and hash, and the list of chunks (hash and size) that form it
+template<bool is_serialize>
+static void deser_manifest(Archive& manifest, Archive& settings, uint32_t& size, uint64_t& hash, std::vector<std::pair<uint64_t, uint32_t>>& chunk_list) {
+    ::deser_dynamic<is_serialize>(manifest, settings.int_mode);
+    ::deser_dynamic<is_serialize>(manifest, settings.float_mode);
+    ::deser_dynamic<is_serialize>(manifest, settings.float_bits);
+    ::deser_dynamic<is_serialize>(manifest, settings.float_scale);
+    bool big_endian = settings.byte_order == std::endian::big;
+    ::deser_dynamic<is_serialize>(manifest, big_endian);
+    if constexpr(!is_serialize)
+        settings.byte_order = big_endian ? std::endian::big : std::endian::little;
+    // Goes onto the string table of the manifest itself
+    ::deser_dynamic<is_serialize>(manifest, settings.string_table);
+    ::deser_dynamic<is_serialize>(manifest, size);
+    ::deser_dynamic<is_serialize>(manifest, hash);
+    ::deser_dynamic<is_serialize>(manifest, chunk_list);
+}
+
+static std::pair<uint32_t, uint64_t> read_manifest(const std::string& manifest_path, Archive& settings, std::vector<std::pair<uint64_t, uint32_t>>& chunk_list) {
+    SectionedArchive sar{};
+    sar.open(manifest_path);
+    auto& manifest = sar.load_section(std::string(manifest_section_name));
+    uint32_t size = 0;
+    uint64_t hash = 0;
+    deser_manifest<false>(manifest, settings, size, hash, chunk_list);
+    return { size, hash };
+}
+
+ArchiveChunkStore::ArchiveChunkStore(const std::string& _path)
+    : path{ _path }
+{
+
+}
+
+std::string ArchiveChunkStore::get_chunk_path(uint64_t hash) const {
+    const auto name = string_format("%016llx", static_cast<unsigned long long>(hash));
+    return path + "/" + name.substr(0, 2) + "/" + name + ".chunk";
+}
+
+/// @brief Registers the chunks already present on the store
+void ArchiveChunkStore::scan() {
+    if(scanned) return;
+    scanned = true;
+    std::error_code ec;
+    if(!std::filesystem::is_directory(path, ec)) return;
+    for(const auto& entry : std::filesystem::recursive_directory_iterator(path, ec)) {
+        if(!entry.is_regular_file() || entry.path().extension() != ".chunk") continue;
+        // Chunks are at least the codec byte, an empty file was never fully written
+        if(entry.file_size(ec) == 0 || ec) continue;
+        const auto stem = entry.path().stem().string();
+        if(stem.size() != 16) continue;
+        known_chunks.insert(std::stoull(stem, nullptr, 16));
+    }
+    Eng3D::Log::debug("archive", string_format("Chunk store %s has %zu chunks", path.c_str(), known_chunks.size()));
+}
+
+/// @brief Splits an archive into content-defined chunks, the boundaries are placed where
+/// the top bits of a gear rolling hash (over the last 64 bytes) are zero
+/// @param ar Archive to split
+/// @return std::vector<ArchiveChunk> The chunks, covering the entire buffer
+std::vector<ArchiveChunk> ArchiveChunkStore::split(const Archive& ar) {
+    std::vector<ArchiveChunk> chunks;
+    const auto& buffer = ar.buffer;
+    for(size_t start = 0; start < buffer.size(); ) {
+        const size_t remaining = buffer.size() - start;
+        size_t size = std::min(remaining, max_chunk_size);
+        if(remaining > min_chunk_size) {
+            uint64_t h = 0;
+            for(size_t i = min_chunk_size; i < size; i++) {
+                h = (h << 1) + gear_table[buffer[start + i]];
+                if(!(h >> (64 - chunk_bits))) {
+                    size = i + 1;
+                    break;
+                }
+            }
+        }
+        ArchiveChunk chunk{};
+        chunk.hash = Eng3D::Hash::xxh64(&buffer[start], size);
+        chunk.offset = start;
+        chunk.size = size;
+        chunks.push_back(chunk);
+        start += size;
+    }
+    return chunks;
+}
+
+/// @brief Saves an archive incrementally, only the chunks that aren't on the store are
+/// written, plus a manifest listing all the chunks of the archive
+/// @param ar Archive to save
+/// @param manifest_path Path of the manifest (which acts as the save file)
+void ArchiveChunkStore::save(const Archive& ar, const std::string& manifest_path) {
+    if(ar.buffer.empty())
+        CXX_THROW(SerializerException, translate("Can't output an empty archive to file"));
+    const auto chunks = ArchiveChunkStore::split(ar);
+
+    std::vector<const ArchiveChunk*> new_chunks;
+    {
+        const std::scoped_lock lock(store_mutex);
+        scan();
+        std::unordered_set<uint64_t> seen;
+        for(const auto& chunk : chunks)
+            if(!known_chunks.contains(chunk.hash) && seen.insert(chunk.hash).second)
+                new_chunks.push_back(&chunk);
+    }
+
+    std::atomic<size_t> written_bytes = 0;
+    tbb::parallel_for(static_cast<size_t>(0), new_chunks.size(), [&](const auto i) {
+        const auto& chunk = *new_chunks[i];
+        // Chunks start with the id of their codec, so saves with different codecs can share them
+        std::vector<uint8_t> dest_buffer(1 + Eng3D::Compression::compress_bound(ar.compression.codec, chunk.size));
+        dest_buffer[0] = static_cast<uint8_t>(ar.compression.codec);
+        dest_buffer.resize(1 + Eng3D::Compression::compress(ar.compression, &ar.buffer[chunk.offset], chunk.size, dest_buffer.data() + 1, dest_buffer.size() - 1));
+
+        const std::filesystem::path chunk_path = get_chunk_path(chunk.hash);
+        std::filesystem::create_directories(chunk_path.parent_path());
+        // Written under a temporary name so a partially written chunk is never picked up, and
+        // synced before being renamed so a crash can't leave a torn chunk under the final name
+        const auto tmp_path = chunk_path.string() + get_tmp_suffix();
+        unique_file fp(::fopen(tmp_path.c_str(), "wb"), ::fclose);
+        bool ok = fp != nullptr && std::fwrite(dest_buffer.data(), 1, dest_buffer.size(), fp.get()) == dest_buffer.size() && sync_file(fp.get());
+        if(fp != nullptr && std::fclose(fp.release()) != 0) ok = false;
+        std::error_code ec;
+        if(ok) std::filesystem::rename(tmp_path, chunk_path, ec);
+        if(!ok || ec) {
+            std::filesystem::remove(tmp_path, ec);
+            CXX_THROW(SerializerException, translate_format("Can't write archive chunk %s", tmp_path.c_str()));
+        }
+        written_bytes += dest_buffer.size();
+    });
+    // The renames must be on the disk before the manifest that references them
+    std::set<std::string> chunk_dirs;
+    for(const auto* chunk : new_chunks)
+        chunk_dirs.insert(std::filesystem::path(get_chunk_path(chunk->hash)).parent_path().string());
+    for(const auto& dir : chunk_dirs)
+        sync_directory(dir);
+    if(!chunk_dirs.empty())
+        sync_directory(path);
+
+    {
+        const std::scoped_lock lock(store_mutex);
+        for(const auto* chunk : new_chunks)
+            known_chunks.insert(chunk->hash);
+    }
+
+    std::vector<std::pair<uint64_t, uint32_t>> chunk_list;
+    for(const auto& chunk : chunks)
+        chunk_list.emplace_back(chunk.hash, chunk.size);
+    SectionedArchive sar{};
+    auto& manifest = sar.add_section(std::string(manifest_section_name));
+    manifest.compression = ar.compression;
+    Archive settings{};
+    settings.int_mode = ar.int_mode;
+    settings.float_mode = ar.float_mode;
+    settings.float_bits = ar.float_bits;
+    settings.float_scale = ar.float_scale;
+    settings.byte_order = ar.byte_order;
+    settings.string_table = ar.string_table;
+    uint32_t size = ar.buffer.size();
+    uint64_t hash = Eng3D::Hash::xxh64(ar.buffer.data(), ar.buffer.size());
+    deser_manifest<true>(manifest, settings, size, hash, chunk_list);
+    sar.to_file(manifest_path);
+
+    last_new_chunks = new_chunks.size();
+    last_reused_chunks = chunks.size() - new_chunks.size();
+    last_written_bytes = written_bytes;
+    Eng3D::Log::debug("archive", string_format("Incremental save %s: %zu new chunks, %zu reused, %zu bytes written", manifest_path.c_str(), last_new_chunks, last_reused_chunks, last_written_bytes));
+}
+
+/// @brief Reads the manifest of a save and reassembles the archive from the chunks
+/// @param ar Archive to load onto
+/// @param manifest_path Path of the manifest
+void ArchiveChunkStore::load(Archive& ar, const std::string& manifest_path) {
+    std::vector<std::pair<uint64_t, uint32_t>> chunk_list;
+    const auto [size, hash] = read_manifest(manifest_path, ar, chunk_list);
+
+    std::vector<size_t> offsets(chunk_list.size());
+    size_t total = 0;
+    for(size_t i = 0; i < chunk_list.size(); i++) {
+        offsets[i] = total;
+        total += chunk_list[i].second;
+    }
+    if(total != size)
+        CXX_THROW(SerializerException, translate_format("Manifest %s is inconsistent", manifest_path.c_str()));
+
+    ar.buffer.resize(size);
+    tbb::parallel_for(static_cast<size_t>(0), chunk_list.size(), [&](const auto i) {
+        const auto [chunk_hash, chunk_size] = chunk_list[i];
+        const auto chunk_path = get_chunk_path(chunk_hash);
+        std::error_code ec;
+        const auto file_size = std::filesystem::file_size(chunk_path, ec);
+        if(ec)
+            CXX_THROW(SerializerException, translate_format("Missing archive chunk %s", chunk_path.c_str()));
+        std::vector<uint8_t> src_buffer(file_size);
+        unique_file fp(::fopen(chunk_path.c_str(), "rb"), ::fclose);
+        if(fp == nullptr || std::fread(src_buffer.data(), 1, src_buffer.size(), fp.get()) != src_buffer.size())
+            CXX_THROW(SerializerException, translate_format("Can't read archive chunk %s", chunk_path.c_str()));
+        auto* dest = &ar.buffer[offsets[i]];
+        if(src_buffer.empty() || !Eng3D::Compression::is_valid_codec(src_buffer[0]))
+            CXX_THROW(SerializerException, translate_format("Corrupted archive chunk %s", chunk_path.c_str()));
+        const auto codec = static_cast<Eng3D::Compression::Codec>(src_buffer[0]);
+        if(Eng3D::Compression::decompress(codec, src_buffer.data() + 1, src_buffer.size() - 1, dest, chunk_size) != chunk_size
+        || Eng3D::Hash::xxh64(dest, chunk_size) != chunk_hash)
+            CXX_THROW(SerializerException, translate_format("Corrupted archive chunk %s", chunk_path.c_str()));
+    });
+    if(Eng3D::Hash::xxh64(ar.buffer.data(), ar.buffer.size()) != hash)
+        CXX_THROW(SerializerException, translate_format("Checksum mismatch on %s", manifest_path.c_str()));
+    ar.rewind();
+}
+
+/// @brief Removes the chunks which aren't referenced by any of the given manifests
+/// @param manifest_paths Manifests of the saves to keep
+void ArchiveChunkStore::prune(const std::vector<std::string>& manifest_paths) {
+    std::unordered_set<uint64_t> referenced;
+    for(const auto& manifest_path : manifest_paths) {
+        Archive settings{};
+        std::vector<std::pair<uint64_t, uint32_t>> chunk_list;
+        read_manifest(manifest_path, settings, chunk_list);
+        for(const auto& [chunk_hash, chunk_size] : chunk_list)
+            referenced.insert(chunk_hash);
+    }
+
+    const std::scoped_lock lock(store_mutex);
+    scan();
+    size_t removed = 0;
+    for(auto it = known_chunks.begin(); it != known_chunks.end(); ) {
+        if(referenced.contains(*it)) {
+            it++;
+            continue;
+        }
+        std::error_code ec;
+        std::filesystem::remove(get_chunk_path(*it), ec);
+        it = known_chunks.erase(it);
+        removed++;
+    }
+    Eng3D::Log::debug("archive", string_format("Pruned %zu chunks from %s", removed, path.c_str()));
+}
@@ -0,0 +1,73 @@
+// Eng3D - General purpouse game engine
+// Copyright (C) 2021, Eng3D contributors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+// Name:
+//      chunk_store.hpp
+//
+// Abstract:
+//      Incremental saving of archives, archives are split into content-defined
+//      chunks which are stored once on a content addressed store, each save
+//      then only needs a small manifest plus the chunks that changed.
+// ----------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <mutex>
+#include "eng3d/serializer.hpp"
+
+/// @brief A chunk of an archive, identified by the hash of it's contents
+struct ArchiveChunk {
+    uint64_t hash = 0;
+    uint32_t offset = 0;
+    uint32_t size = 0;
+};
+
+/// @brief Content addressed storage of archive chunks. Chunk boundaries are determined
+/// by a rolling hash over the contents (and not by fixed offsets), so inserting or
+/// removing data only affects the chunks around the change
+class ArchiveChunkStore {
+    void scan();
+    std::string get_chunk_path(uint64_t hash) const;
+
+    std::unordered_set<uint64_t> known_chunks;
+    bool scanned = false;
+    std::mutex store_mutex;
+public:
+    ArchiveChunkStore(const std::string& path);
+    ~ArchiveChunkStore() = default;
+    static std::vector<ArchiveChunk> split(const Archive& ar);
+    void save(const Archive& ar, const std::string& manifest_path);
+    void load(Archive& ar, const std::string& manifest_path);
+    void prune(const std::vector<std::string>& manifest_paths);
+
+    constexpr static size_t min_chunk_size = 2048;
+    constexpr static size_t max_chunk_size = 65536;
+    /// @brief Average chunk size (past the minimum) is 2^chunk_bits
+    constexpr static unsigned chunk_bits = 13;
+
+    /// @brief Directory where the chunks are stored
+    std::string path;
+    /// @brief Statistics of the last save
+    size_t last_new_chunks = 0;
+    size_t last_reused_chunks = 0;
+    size_t last_written_bytes = 0;
+};
@@ -0,0 +1,245 @@
+// Eng3D - General purpouse game engine
+// Copyright (C) 2021, Eng3D contributors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+// Name:
+//      codec.cpp
+//
+// Abstract:
+//      Implements the LZ codec and the dispatch to each of the codecs. The LZ
+//      format is made of sequences of a token (literal length and match length
+//      nibbles), extra literal length bytes, literals, a 16-bit offset and extra
+//      match length bytes. The last sequence has only literals.
+// ----------------------------------------------------------------------------
+
+#include <cstring>
+#include <bit>
+#include <array>
+#include <algorithm>
+#include <stdexcept>
+#include "eng3d/codec.hpp"
+#include "eng3d/compress.hpp"
+#include "eng3d/utils.hpp"
+
+constexpr size_t lz_min_match = 4;
+constexpr size_t lz_last_literals = 5; // The stream always ends with some literals
+constexpr size_t lz_match_limit = 12; // No match starts on the last bytes
+constexpr size_t lz_max_offset = 65535;
+constexpr unsigned lz_hash_bits = 14;
+
+template<typename T>
+static inline T read_raw(const uint8_t* p) {
+    T value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t lz_hash(uint32_t sequence) {
+    return (sequence * 2654435761U) >> (32 - lz_hash_bits);
+}
+
+/// @brief Number of equal bytes between a and b, without going past limit on a
+static inline size_t lz_count(const uint8_t* a, const uint8_t* b, const uint8_t* limit) {
+    const auto* start = a;
+    while(a + sizeof(uint64_t) <= limit) {
+        const auto diff = read_raw<uint64_t>(a) ^ read_raw<uint64_t>(b);
+        if(diff) {
+            if constexpr(std::endian::native == std::endian::little)
+                return (a - start) + (std::countr_zero(diff) >> 3);
+            else
+                return (a - start) + (std::countl_zero(diff) >> 3);
+        }
+        a += sizeof(uint64_t);
+        b += sizeof(uint64_t);
+    }
+    while(a < limit && *a == *b) {
+        a++;
+        b++;
+    }
+    return a - start;
+}
+
+static inline uint8_t* lz_write_length(uint8_t* op, size_t len) {
+    for(; len >= 255; len -= 255)
+        *op++ = 255;
+    *op++ = static_cast<uint8_t>(len);
+    return op;
+}
+
+size_t Eng3D::Lz::compress(const void* src, size_t src_len, void* dest, size_t dest_len) {
+    if(dest_len < Eng3D::Lz::compress_bound(src_len))
+        CXX_THROW(std::runtime_error, "Insufficient output buffer size for LZ compression");
+    const auto* in = static_cast<const uint8_t*>(src);
+    auto* op = static_cast<uint8_t*>(dest);
+    // Entries from previous calls are harmless, candidates are always verified
+    thread_local std::array<uint32_t, 1 << lz_hash_bits> table;
+
+    size_t anchor = 0;
+    if(src_len >= lz_match_limit) {
+        const auto* match_end = in + src_len - lz_last_literals;
+        const size_t search_limit = src_len - lz_match_limit;
+        size_t pos = 0, misses = 0;
+        while(pos <= search_limit) {
+            const auto sequence = read_raw<uint32_t>(in + pos);
+            const auto h = lz_hash(sequence);
+            size_t ref = table[h];
+            table[h] = static_cast<uint32_t>(pos);
+            if(ref >= pos || pos - ref > lz_max_offset || read_raw<uint32_t>(in + ref) != sequence) {
+                pos += 1 + (misses++ >> 6); // Skip faster over incompressible data
+                continue;
+            }
+            misses = 0;
+            while(pos > anchor && ref > 0 && in[pos - 1] == in[ref - 1]) {
+                pos--;
+                ref--;
+            }
+            const size_t len = lz_min_match + lz_count(in + pos + lz_min_match, in + ref + lz_min_match, match_end);
+
+            const size_t literals = pos - anchor;
+            const size_t extra_len = len - lz_min_match;
+            *op++ = static_cast<uint8_t>((std::min<size_t>(literals, 15) << 4) | std::min<size_t>(extra_len, 15));
+            if(literals >= 15)
+                op = lz_write_length(op, literals - 15);
+            std::memcpy(op, in + anchor, literals);
+            op += literals;
+            const auto offset = static_cast<uint16_t>(pos - ref);
+            *op++ = static_cast<uint8_t>(offset);
+            *op++ = static_cast<uint8_t>(offset >> 8);
+            if(extra_len >= 15)
+                op = lz_write_length(op, extra_len - 15);
+
+            pos += len;
+            anchor = pos;
+            if(pos <= search_limit) // Helps finding a match right after this one
+                table[lz_hash(read_raw<uint32_t>(in + pos - 2))] = static_cast<uint32_t>(pos - 2);
+        }
+    }
+
+    const size_t literals = src_len - anchor;
+    *op++ = static_cast<uint8_t>(std::min<size_t>(literals, 15) << 4);
+    if(literals >= 15)
+        op = lz_write_length(op, literals - 15);
+    if(literals)
+        std::memcpy(op, in + anchor, literals);
+    op += literals;
+    return op - static_cast<uint8_t*>(dest);
+}
+
+size_t Eng3D::Lz::decompress(const void* src, size_t src_len, void* dest, size_t dest_len) {
+    const auto* ip = static_cast<const uint8_t*>(src);
+    const auto* const iend = ip + src_len;
+    auto* const out = static_cast<uint8_t*>(dest);
+    auto* op = out;
+    auto* const oend = out + dest_len;
+    const auto read_length = [&](size_t len) {
+        uint8_t b;
+        do {
+            if(ip >= iend)
+                CXX_THROW(std::runtime_error, "Malformed LZ stream");
+            b = *ip++;
+            len += b;
+        } while(b == 255);
+        return len;
+    };
+
+    while(ip < iend) {
+        const uint8_t token = *ip++;
+        size_t literals = token >> 4;
+        if(literals == 15)
+            literals = read_length(literals);
+        if(literals > static_cast<size_t>(iend - ip) || literals > static_cast<size_t>(oend - op))
+            CXX_THROW(std::runtime_error, "Malformed LZ stream");
+        if(literals)
+            std::memcpy(op, ip, literals);
+        op += literals;
+        ip += literals;
+        if(ip == iend) break; // Last sequence
+
+        if(iend - ip < 2)
+            CXX_THROW(std::runtime_error, "Malformed LZ stream");
+        const size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        size_t len = token & 15;
+        if(len == 15)
+            len = read_length(len);
+        len += lz_min_match;
+        if(!offset || offset > static_cast<size_t>(op - out) || len > static_cast<size_t>(oend - op))
+            CXX_THROW(std::runtime_error, "Malformed LZ stream");
+        const auto* match = op - offset;
+        if(offset >= len) {
+            std::memcpy(op, match, len);
+            op += len;
+        } else { // Overlapping, repeats the last offset bytes
+            auto* const match_end = op + len;
+            if(offset >= sizeof(uint64_t)) {
+                for(; op + sizeof(uint64_t) <= match_end; op += sizeof(uint64_t), match += sizeof(uint64_t))
+                    std::memcpy(op, match, sizeof(uint64_t));
+            }
+            while(op < match_end)
+                *op++ = *match++;
+        }
+    }
+    return op - out;
+}
+
+//
+// Codec dispatch
+//
+size_t Eng3D::Compression::compress_bound(Codec codec, size_t src_len) {
+    switch(codec) {
+    case Codec::NONE: return src_len;
+    case Codec::ZLIB: return Eng3D::Zlib::compress_bound(src_len);
+    case Codec::LZ: return Eng3D::Lz::compress_bound(src_len);
+    }
+    CXX_THROW(std::runtime_error, "Unknown compression codec");
+}
+
+size_t Eng3D::Compression::compress(Settings settings, const void* src, size_t src_len, void* dest, size_t dest_len) {
+    switch(settings.codec) {
+    case Codec::NONE:
+        if(dest_len < src_len)
+            CXX_THROW(std::runtime_error, "Insufficient output buffer size");
+        if(src_len)
+            std::memcpy(dest, src, src_len);
+        return src_len;
+    case Codec::ZLIB: return Eng3D::Zlib::compress(src, src_len, dest, dest_len, settings.level);
+    case Codec::LZ: return Eng3D::Lz::compress(src, src_len, dest, dest_len);
+    }
+    CXX_THROW(std::runtime_error, "Unknown compression codec");
+}
+
+size_t Eng3D::Compression::decompress(Codec codec, const void* src, size_t src_len, void* dest, size_t dest_len) {
+    switch(codec) {
+    case Codec::NONE:
+        if(dest_len < src_len)
+            CXX_THROW(std::runtime_error, "Insufficient output buffer size");
+        if(src_len)
+            std::memcpy(dest, src, src_len);
+        return src_len;
+    case Codec::ZLIB: return Eng3D::Zlib::decompress(src, src_len, dest, dest_len);
+    case Codec::LZ: return Eng3D::Lz::decompress(src, src_len, dest, dest_len);
+    }
+    CXX_THROW(std::runtime_error, "Unknown compression codec");
+}
+
+const char* Eng3D::Compression::get_name(Codec codec) {
+    switch(codec) {
+    case Codec::NONE: return "none";
+    case Codec::ZLIB: return "zlib";
+    case Codec::LZ: return "lz";
+    }
+    return "unknown";
+}
@@ -0,0 +1,84 @@
+// Eng3D - General purpouse game engine
+// Copyright (C) 2021, Eng3D contributors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+// Name:
+//      codec.hpp
+//
+// Abstract:
+//      Selection of the compression codec used by archives, and an in-tree LZ
+//      codec which favours speed over ratio.
+// ----------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Eng3D::Lz {
+    /// @brief Worst case size of the compressed form of src_len bytes
+    constexpr size_t compress_bound(size_t src_len) {
+        return src_len + src_len / 255 + 16;
+    }
+    size_t compress(const void* src, size_t src_len, void* dest, size_t dest_len);
+    size_t decompress(const void* src, size_t src_len, void* dest, size_t dest_len);
+}
+
+namespace Eng3D::Compression {
+    /// @brief Codec ids, these are stored on files so they must not be renumbered
+    enum class Codec : uint8_t {
+        NONE = 0, // Stored as-is
+        ZLIB = 1, // Deflate, with a level from 1 (fastest) to 9 (smallest)
+        LZ = 2, // Byte-oriented LZ77, several times faster than zlib at level 1
+    };
+
+    /// @brief Whetever an id read from a file names a known codec
+    constexpr bool is_valid_codec(uint8_t id) {
+        return id <= static_cast<uint8_t>(Codec::LZ);
+    }
+
+    /// @brief Common trade-offs between size and speed
+    enum class Preset : uint8_t {
+        AUTOSAVE, // Taken often while playing, must not stall
+        MANUAL_SAVE, // Kept around, size matters more
+        NETWORK, // Sent right away, small payloads
+    };
+
+    struct Settings {
+        Codec codec = Codec::ZLIB;
+        int level = 6;
+
+        constexpr Settings() = default;
+        constexpr Settings(Codec _codec, int _level = 6)
+            : codec{ _codec },
+            level{ _level }
+        {
+
+        }
+        constexpr Settings(Preset preset) {
+            switch(preset) {
+            case Preset::AUTOSAVE: codec = Codec::LZ; break;
+            case Preset::MANUAL_SAVE: codec = Codec::ZLIB; level = 9; break;
+            case Preset::NETWORK: codec = Codec::ZLIB; level = 1; break;
+            }
+        }
+    };
+
+    size_t compress_bound(Codec codec, size_t src_len);
+    size_t compress(Settings settings, const void* src, size_t src_len, void* dest, size_t dest_len);
+    size_t decompress(Codec codec, const void* src, size_t src_len, void* dest, size_t dest_len);
+    const char* get_name(Codec codec);
+}
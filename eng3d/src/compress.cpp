@@ -0,0 +1,276 @@
+// Eng3D - General purpouse game engine
+// Copyright (C) 2021, Eng3D contributors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+// Name:
+//      compress.cpp
+//
+// Abstract:
+//      Implements the reusable zlib streams and the preset dictionary trainer.
+// ----------------------------------------------------------------------------
+
+#include <stdexcept>
+#include <algorithm>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstring>
+#include "eng3d/compress.hpp"
+#include "eng3d/utils.hpp"
+
+//
+// Deflate
+//
+Eng3D::Zlib::Deflate::Deflate(int _level, int _strategy)
+    : level{ _level },
+    strategy{ _strategy }
+{
+    if(deflateInit2(&stream, level, Z_DEFLATED, MAX_WBITS, 8, strategy) != Z_OK)
+        CXX_THROW(std::runtime_error, "Can't initialize zlib deflate stream");
+}
+
+Eng3D::Zlib::Deflate::~Deflate() {
+    deflateEnd(&stream);
+}
+
+/// @brief Changes the compression level and strategy, takes effect on the next stream
+void Eng3D::Zlib::Deflate::set_params(int _level, int _strategy) {
+    level = _level;
+    strategy = _strategy;
+    deflateReset(&stream);
+    if(deflateParams(&stream, level, strategy) != Z_OK)
+        CXX_THROW(std::runtime_error, "Invalid zlib deflate parameters");
+    reset();
+}
+
+/// @brief Sets a preset dictionary, which is kept across resets. Small payloads sharing
+/// common substrings with the dictionary compress far better
+void Eng3D::Zlib::Deflate::set_dictionary(const void* dict, size_t dict_len) {
+    const auto* p = static_cast<const uint8_t*>(dict);
+    dictionary.assign(p, p + dict_len);
+    reset();
+}
+
+/// @brief Starts a new stream, keeping the allocated state
+void Eng3D::Zlib::Deflate::reset() {
+    deflateReset(&stream);
+    if(!dictionary.empty())
+        deflateSetDictionary(&stream, dictionary.data(), dictionary.size());
+}
+
+/// @brief Compresses as much of the input as possible onto the output, can be called
+/// repeatedly with more input or more output space
+/// @param finish Whetever this is the last of the input
+Eng3D::Zlib::StreamResult Eng3D::Zlib::Deflate::write(const void* src, size_t src_len, void* dest, size_t dest_len, bool finish) {
+    stream.next_in = const_cast<Bytef*>(static_cast<const Bytef*>(src));
+    stream.avail_in = src_len;
+    stream.next_out = static_cast<Bytef*>(dest);
+    stream.avail_out = dest_len;
+    const int r = deflate(&stream, finish ? Z_FINISH : Z_NO_FLUSH);
+    if(r != Z_OK && r != Z_STREAM_END && r != Z_BUF_ERROR)
+        CXX_THROW(std::runtime_error, "zlib deflate error");
+    StreamResult result{};
+    result.consumed = src_len - stream.avail_in;
+    result.produced = dest_len - stream.avail_out;
+    result.finished = r == Z_STREAM_END;
+    return result;
+}
+
+/// @brief Compresses the whole input as a single stream
+/// @return size_t Size of the compressed data
+size_t Eng3D::Zlib::Deflate::compress(const void* src, size_t src_len, void* dest, size_t dest_len) {
+    reset();
+    const auto r = write(src, src_len, dest, dest_len, true);
+    if(!r.finished)
+        CXX_THROW(std::runtime_error, "Insufficient zlib output buffer size for deflate");
+    return r.produced;
+}
+
+/// @brief Worst case compressed size with the current parameters
+size_t Eng3D::Zlib::Deflate::bound(size_t src_len) {
+    // zlib only accounts for the dictionary id while the dictionary is pending on the stream
+    return deflateBound(&stream, src_len) + (dictionary.empty() ? 0 : sizeof(uint32_t));
+}
+
+//
+// Inflate
+//
+Eng3D::Zlib::Inflate::Inflate() {
+    if(inflateInit(&stream) != Z_OK)
+        CXX_THROW(std::runtime_error, "Can't initialize zlib inflate stream");
+}
+
+Eng3D::Zlib::Inflate::~Inflate() {
+    inflateEnd(&stream);
+}
+
+/// @brief Sets the dictionary the data was compressed with, it's given to zlib when
+/// the stream asks for it
+void Eng3D::Zlib::Inflate::set_dictionary(const void* dict, size_t dict_len) {
+    const auto* p = static_cast<const uint8_t*>(dict);
+    dictionary.assign(p, p + dict_len);
+}
+
+/// @brief Starts a new stream, keeping the allocated state
+void Eng3D::Zlib::Inflate::reset() {
+    inflateReset(&stream);
+}
+
+/// @brief Decompresses as much of the input as possible onto the output, can be called
+/// repeatedly with more input or more output space
+Eng3D::Zlib::StreamResult Eng3D::Zlib::Inflate::write(const void* src, size_t src_len, void* dest, size_t dest_len) {
+    stream.next_in = const_cast<Bytef*>(static_cast<const Bytef*>(src));
+    stream.avail_in = src_len;
+    // zlib rejects a null output even when there is nothing to write
+    Bytef empty_out;
+    stream.next_out = dest != nullptr ? static_cast<Bytef*>(dest) : &empty_out;
+    stream.avail_out = dest_len;
+    int r = inflate(&stream, Z_NO_FLUSH);
+    if(r == Z_NEED_DICT) {
+        if(dictionary.empty() || inflateSetDictionary(&stream, dictionary.data(), dictionary.size()) != Z_OK)
+            CXX_THROW(std::runtime_error, "zlib stream needs a different dictionary");
+        r = inflate(&stream, Z_NO_FLUSH);
+    }
+    if(r != Z_OK && r != Z_STREAM_END && r != Z_BUF_ERROR)
+        CXX_THROW(std::runtime_error, "zlib inflate error");
+    StreamResult result{};
+    result.consumed = src_len - stream.avail_in;
+    result.produced = dest_len - stream.avail_out;
+    result.finished = r == Z_STREAM_END;
+    return result;
+}
+
+/// @brief Decompresses a whole stream
+/// @return size_t Size of the decompressed data
+size_t Eng3D::Zlib::Inflate::decompress(const void* src, size_t src_len, void* dest, size_t dest_len) {
+    reset();
+    const auto r = write(src, src_len, dest, dest_len);
+    if(!r.finished)
+        CXX_THROW(std::runtime_error, "Insufficient zlib output buffer size for inflate");
+    return r.produced;
+}
+
+//
+// One-shot helpers, each thread keeps its own streams
+//
+size_t Eng3D::Zlib::compress(const void* src, size_t src_len, void* dest, size_t dest_len, int level) {
+    thread_local Eng3D::Zlib::Deflate stream;
+    if(stream.get_level() != level)
+        stream.set_params(level, stream.get_strategy());
+    return stream.compress(src, src_len, dest, dest_len);
+}
+
+size_t Eng3D::Zlib::decompress(const void* src, size_t src_len, void* dest, size_t dest_len) {
+    thread_local Eng3D::Zlib::Inflate stream;
+    return stream.decompress(src, src_len, dest, dest_len);
+}
+
+//
+// Dictionary training
+//
+constexpr size_t dict_kmer_size = 8;
+constexpr size_t dict_segment_size = 64;
+
+static inline uint64_t read_kmer(const uint8_t* p) {
+    uint64_t kmer;
+    std::memcpy(&kmer, p, sizeof(kmer));
+    return kmer;
+}
+
+/// @brief Trains a preset dictionary out of sample payloads. Segments of the samples
+/// are scored by how many samples share their 8-byte substrings, and picked greedily,
+/// substrings already on the dictionary no longer count towards the score.
+/// The best segments go last, where they are the cheapest to reference
+/// @param samples Representative payloads, ideally many small ones
+/// @param dict_size Maximum size of the dictionary
+/// @return std::vector<uint8_t> The dictionary
+std::vector<uint8_t> Eng3D::Zlib::train_dictionary(const std::vector<std::vector<uint8_t>>& samples, size_t dict_size) {
+    static_assert(dict_kmer_size == sizeof(uint64_t));
+    dict_size = std::min(dict_size, max_dictionary_size);
+
+    // Number of samples where each substring appears
+    std::unordered_map<uint64_t, uint32_t> frequencies;
+    for(const auto& sample : samples) {
+        if(sample.size() < dict_kmer_size) continue;
+        std::unordered_set<uint64_t> seen;
+        for(size_t i = 0; i + dict_kmer_size <= sample.size(); i++)
+            if(const auto kmer = read_kmer(&sample[i]); seen.insert(kmer).second)
+                frequencies[kmer]++;
+    }
+
+    struct Segment {
+        uint64_t score;
+        uint32_t sample;
+        uint32_t offset;
+        uint32_t size;
+        bool operator<(const Segment& rhs) const {
+            return score < rhs.score;
+        }
+    };
+    const auto get_score = [&](const Segment& segment) {
+        const auto* p = &samples[segment.sample][segment.offset];
+        std::unordered_set<uint64_t> seen;
+        uint64_t score = 0;
+        for(size_t i = 0; i + dict_kmer_size <= segment.size; i++) {
+            const auto kmer = read_kmer(p + i);
+            if(!seen.insert(kmer).second) continue;
+            const auto freq = frequencies[kmer];
+            score += freq > 1 ? freq : 0; // Substrings on a single sample are worthless
+        }
+        return score;
+    };
+
+    // Candidates are overlapping segments, scores can only decrease as segments are
+    // picked, so they are re-evaluated lazily when they reach the top of the queue
+    std::priority_queue<Segment> candidates;
+    for(size_t i = 0; i < samples.size(); i++) {
+        const auto& sample = samples[i];
+        if(sample.size() < dict_kmer_size) continue;
+        for(size_t offset = 0; offset < sample.size(); offset += dict_segment_size / 2) {
+            Segment segment{ 0, static_cast<uint32_t>(i), static_cast<uint32_t>(offset), static_cast<uint32_t>(std::min(dict_segment_size, sample.size() - offset)) };
+            if(segment.size < dict_kmer_size) continue;
+            segment.score = get_score(segment);
+            if(segment.score) candidates.push(segment);
+        }
+    }
+
+    std::vector<Segment> picked;
+    size_t total_size = 0;
+    while(!candidates.empty() && total_size < dict_size) {
+        auto segment = candidates.top();
+        candidates.pop();
+        segment.score = get_score(segment);
+        if(!segment.score) continue;
+        if(!candidates.empty() && segment.score < candidates.top().score) {
+            candidates.push(segment); // Lost value since it was scored, try again later
+            continue;
+        }
+        segment.size = std::min<size_t>(segment.size, dict_size - total_size);
+        const auto* p = &samples[segment.sample][segment.offset];
+        for(size_t i = 0; i + dict_kmer_size <= segment.size; i++)
+            frequencies[read_kmer(p + i)] = 0;
+        picked.push_back(segment);
+        total_size += segment.size;
+    }
+
+    std::vector<uint8_t> dictionary;
+    dictionary.reserve(total_size);
+    for(auto it = picked.rbegin(); it != picked.rend(); it++) {
+        const auto* p = &samples[it->sample][it->offset];
+        dictionary.insert(dictionary.end(), p, p + it->size);
+    }
+    return dictionary;
+}
@@ -19,49 +19,81 @@
 //      compress.hpp
 //
 // Abstract:
-//      Does some important stuff.
+//      Wrappers around zlib, with reusable compression and decompression streams.
 // ----------------------------------------------------------------------------
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <vector>
 #include <zlib.h>
 
 namespace Eng3D::Zlib {
-    size_t compress(const void* src, size_t src_len, void* dest, size_t dest_len) {
-        z_stream info = {};
-        info.avail_in = src_len;
-        info.avail_out = dest_len;
-        info.next_in = (Bytef*)src;
-        info.next_out = (Bytef*)dest;
-        info.data_type = Z_BINARY;
+    /// @brief Result of feeding a stream
+    struct StreamResult {
+        size_t consumed = 0; // Bytes taken from the input
+        size_t produced = 0; // Bytes written onto the output
+        bool finished = false; // Whetever the end of the stream was reached
+    };
 
-        int r = deflateInit(&info, Z_DEFAULT_COMPRESSION);
-        if(r == Z_OK) {
-            r = deflate(&info, Z_FINISH);
-            if(r == Z_STREAM_END) {
-                deflateEnd(&info);
-                return info.total_out;
-            }
-        }
-        CXX_THROW(std::runtime_error, "Insufficient zlib output buffer size for deflate");
-    }
+    /// @brief Deflate stream whose state is kept between uses, so compressing many
+    /// payloads only pays for the allocation of the zlib state once
+    class Deflate {
+        z_stream stream = {};
+        int level;
+        int strategy;
+        std::vector<uint8_t> dictionary;
+    public:
+        Deflate(int level = Z_DEFAULT_COMPRESSION, int strategy = Z_DEFAULT_STRATEGY);
+        ~Deflate();
+        Deflate(const Deflate&) = delete;
+        Deflate& operator=(const Deflate&) = delete;
 
-    size_t decompress(const void* src, size_t src_len, void* dest, size_t dest_len) {
-        z_stream info = {};
-        info.avail_in = src_len;
-        info.avail_out = dest_len;
-        info.next_in = (Bytef*)src;
-        info.next_out = (Bytef*)dest;
-        info.data_type = Z_BINARY;
+        void set_params(int level, int strategy = Z_DEFAULT_STRATEGY);
+        void set_dictionary(const void* dict, size_t dict_len);
+        void reset();
+        StreamResult write(const void* src, size_t src_len, void* dest, size_t dest_len, bool finish);
+        size_t compress(const void* src, size_t src_len, void* dest, size_t dest_len);
+        size_t bound(size_t src_len);
 
-        int r = inflateInit(&info);
-        if(r == Z_OK) {
-            r = inflate(&info, Z_FINISH);
-            if(r == Z_STREAM_END) {
-                inflateEnd(&info);
-                return info.total_out;
-            }
+        int get_level() const {
+            return level;
         }
-        CXX_THROW(std::runtime_error, "Insufficient zlib output buffer size for inflate");
+
+        int get_strategy() const {
+            return strategy;
+        }
+    };
+
+    /// @brief Inflate stream whose state is kept between uses
+    class Inflate {
+        z_stream stream = {};
+        std::vector<uint8_t> dictionary;
+    public:
+        Inflate();
+        ~Inflate();
+        Inflate(const Inflate&) = delete;
+        Inflate& operator=(const Inflate&) = delete;
+
+        void set_dictionary(const void* dict, size_t dict_len);
+        void reset();
+        StreamResult write(const void* src, size_t src_len, void* dest, size_t dest_len);
+        size_t decompress(const void* src, size_t src_len, void* dest, size_t dest_len);
+    };
+
+    /// @brief Worst case size of the compressed form of src_len bytes
+    inline size_t compress_bound(size_t src_len) {
+        return ::compressBound(src_len);
     }
+
+    size_t compress(const void* src, size_t src_len, void* dest, size_t dest_len, int level = Z_DEFAULT_COMPRESSION);
+    size_t decompress(const void* src, size_t src_len, void* dest, size_t dest_len);
+
+    /// @brief Deflate can only reference the last 32KB of a dictionary
+    constexpr size_t max_dictionary_size = 32768;
+    /// @brief Setting a dictionary costs time proportional to its size on every stream,
+    /// small dictionaries get most of the gains on small payloads
+    constexpr size_t default_dictionary_size = 4096;
+    std::vector<uint8_t> train_dictionary(const std::vector<std::vector<uint8_t>>& samples, size_t dict_size = default_dictionary_size);
 }
@@ -28,6 +28,9 @@
 #include <codecvt>
 #include <locale>
 #include <sstream>
+#include <charconv>
+#include <string_view>
+#include <algorithm>
 
 #include "eng3d/font_sdf.hpp"
 #include "eng3d/state.hpp"
@@ -50,7 +53,7 @@ Eng3D::FontSDF::FontSDF(const std::string& filename) {
     auto& s = Eng3D::State::get_instance();
     sphere_shader = std::make_unique<Eng3D::OpenGL::Program>();
     {
-        auto vs_shader = Eng3D::OpenGL::VertexShader(s.package_man.get_unique("shaders/sphere_mapping.vs")->read_all());
+        auto vs_shader = Eng3D::OpenGL::VertexShader(s.package_man.get_unique("shaders/sphere_mapping.vs")->get_view().str());
         sphere_shader->attach_shader(vs_shader);
         sphere_shader->attach_shader(*s.builtin_shaders["fs_font_sdf"].get());
         sphere_shader->link();
@@ -70,29 +73,39 @@ Eng3D::FontSDF::FontSDF(const std::string& filename) {
     mipmap_options.compressed = false;
 
     auto asset = s.package_man.get_unique(filename + ".png");
-    atlas = s.tex_man.load(asset->abs_path, mipmap_options);
-
-    char buff;
-    uint32_t unicode;
-    float advance, top, bottom, left, right;
-    std::string line;
-    std::ifstream glyph_data(s.package_man.get_unique(filename + ".csv")->abs_path);
-    if(glyph_data.is_open()) {
-        while(std::getline(glyph_data, line)) {
-            std::istringstream data(line);
-            data >> unicode >> buff;
-            data >> advance >> buff;
-            data >> left >> buff >> bottom >> buff >> right >> buff >> top >> buff;
-            Eng3D::Rectangle plane_bounds(left, top, right - left, bottom - top);
-            data >> left >> buff >> bottom >> buff >> right >> buff >> top;
-            left /= atlas->width;
-            right /= atlas->width;
-            top /= atlas->height;
-            bottom /= atlas->height;
-            Eng3D::Rectangle atlas_bounds(left, top, right - left, bottom - top);
-            Eng3D::Glyph glyph(advance, atlas_bounds, plane_bounds);
-            unicode_map.insert({ unicode, glyph });
+    atlas = s.tex_man.load(asset, mipmap_options);
+
+    // Each line is: unicode, advance, plane bounds (left, bottom, right, top) and atlas
+    // bounds (same order), parsed straight from the view of the file
+    const auto glyph_view = s.package_man.get_unique(filename + ".csv")->get_view();
+    std::string_view glyph_data = glyph_view.str();
+    while(!glyph_data.empty()) {
+        const auto line_end = std::min(glyph_data.find('\n'), glyph_data.size());
+        std::string_view line = glyph_data.substr(0, line_end);
+        glyph_data.remove_prefix(std::min(line_end + 1, glyph_data.size()));
+
+        float values[10];
+        size_t n_values = 0;
+        for(; n_values < std::size(values) && !line.empty(); n_values++) {
+            while(!line.empty() && (line.front() == ' ' || line.front() == ','))
+                line.remove_prefix(1);
+            const auto r = std::from_chars(line.data(), line.data() + line.size(), values[n_values]);
+            if(r.ec != std::errc()) break;
+            line.remove_prefix(r.ptr - line.data());
         }
+        if(n_values != std::size(values)) continue;
+
+        const auto unicode = static_cast<uint32_t>(values[0]);
+        const float advance = values[1];
+        float left = values[2], bottom = values[3], right = values[4], top = values[5];
+        Eng3D::Rectangle plane_bounds(left, top, right - left, bottom - top);
+        left = values[6] / atlas->width;
+        bottom = values[7] / atlas->height;
+        right = values[8] / atlas->width;
+        top = values[9] / atlas->height;
+        Eng3D::Rectangle atlas_bounds(left, top, right - left, bottom - top);
+        Eng3D::Glyph glyph(advance, atlas_bounds, plane_bounds);
+        unicode_map.insert({ unicode, glyph });
     }
 }
 
@@ -0,0 +1,189 @@
+// Eng3D - General purpouse game engine
+// Copyright (C) 2021, Eng3D contributors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+// Name:
+//      hash.cpp
+//
+// Abstract:
+//      Implements XXH64 as described on the xxHash specification, and CRC32C
+//      with hardware acceleration where available.
+// ----------------------------------------------------------------------------
+
+#include <cstring>
+#include <bit>
+#include <array>
+#if defined __x86_64__ || defined _M_X64
+#   include <immintrin.h>
+#elif defined __ARM_FEATURE_CRC32
+#   include <arm_acle.h>
+#endif
+#include "eng3d/hash.hpp"
+#include "eng3d/utils.hpp"
+
+constexpr uint64_t prime64_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t prime64_3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t prime64_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t prime64_5 = 0x27D4EB2F165667C5ULL;
+
+template<typename T>
+static inline T read_le(const uint8_t* p) {
+    T value;
+    std::memcpy(&value, p, sizeof(value));
+    if constexpr(std::endian::native == std::endian::big)
+        value = std::byteswap<T>(value);
+    return value;
+}
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+    acc += input * prime64_2;
+    acc = std::rotl(acc, 31);
+    return acc * prime64_1;
+}
+
+static inline uint64_t xxh64_merge(uint64_t acc, uint64_t val) {
+    acc ^= xxh64_round(0, val);
+    return acc * prime64_1 + prime64_4;
+}
+
+uint64_t Eng3D::Hash::xxh64(const void* data, size_t size, uint64_t seed) {
+    const auto* p = static_cast<const uint8_t*>(data);
+    const auto* const end = p + size;
+    uint64_t h;
+    if(size >= 32) {
+        // Four independent lanes of 8 bytes each
+        uint64_t v1 = seed + prime64_1 + prime64_2;
+        uint64_t v2 = seed + prime64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - prime64_1;
+        for(const auto* limit = end - 32; p <= limit; p += 32) {
+            v1 = xxh64_round(v1, read_le<uint64_t>(p));
+            v2 = xxh64_round(v2, read_le<uint64_t>(p + 8));
+            v3 = xxh64_round(v3, read_le<uint64_t>(p + 16));
+            v4 = xxh64_round(v4, read_le<uint64_t>(p + 24));
+        }
+        h = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+        h = xxh64_merge(h, v1);
+        h = xxh64_merge(h, v2);
+        h = xxh64_merge(h, v3);
+        h = xxh64_merge(h, v4);
+    } else {
+        h = seed + prime64_5;
+    }
+    h += static_cast<uint64_t>(size);
+
+    for(; p + 8 <= end; p += 8)
+        h = std::rotl(h ^ xxh64_round(0, read_le<uint64_t>(p)), 27) * prime64_1 + prime64_4;
+    if(p + 4 <= end) {
+        h = std::rotl(h ^ (static_cast<uint64_t>(read_le<uint32_t>(p)) * prime64_1), 23) * prime64_2 + prime64_3;
+        p += 4;
+    }
+    for(; p < end; p++)
+        h = std::rotl(h ^ (static_cast<uint64_t>(*p) * prime64_5), 11) * prime64_1;
+
+    // Avalanche
+    h ^= h >> 33;
+    h *= prime64_2;
+    h ^= h >> 29;
+    h *= prime64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+/// @brief Slicing-by-8 tables for the reflected Castagnoli polynomial
+constexpr auto crc32c_table = []() {
+    std::array<std::array<uint32_t, 256>, 8> table{};
+    for(uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for(size_t j = 0; j < 8; j++)
+            crc = (crc >> 1) ^ (0x82F63B78 & (~(crc & 1) + 1));
+        table[0][i] = crc;
+    }
+    for(uint32_t i = 0; i < 256; i++)
+        for(size_t j = 1; j < 8; j++)
+            table[j][i] = (table[j - 1][i] >> 8) ^ table[0][table[j - 1][i] & 0xFF];
+    return table;
+}();
+
+static uint32_t crc32c_sw(const uint8_t* p, size_t size, uint32_t crc) {
+    for(; size >= 8; p += 8, size -= 8) {
+        const uint32_t lo = read_le<uint32_t>(p) ^ crc;
+        const uint32_t hi = read_le<uint32_t>(p + 4);
+        crc = crc32c_table[7][lo & 0xFF] ^ crc32c_table[6][(lo >> 8) & 0xFF]
+            ^ crc32c_table[5][(lo >> 16) & 0xFF] ^ crc32c_table[4][lo >> 24]
+            ^ crc32c_table[3][hi & 0xFF] ^ crc32c_table[2][(hi >> 8) & 0xFF]
+            ^ crc32c_table[1][(hi >> 16) & 0xFF] ^ crc32c_table[0][hi >> 24];
+    }
+    for(; size; p++, size--)
+        crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *p) & 0xFF];
+    return crc;
+}
+
+#if defined __x86_64__ || defined _M_X64
+#   if defined __GNUC__ && !defined __SSE4_2__
+// Built for a baseline CPU, the instructions are only used after checking for them
+#       define CRC32C_HW_TARGET __attribute__((target("sse4.2")))
+#   else
+#       define CRC32C_HW_TARGET
+#   endif
+CRC32C_HW_TARGET static uint32_t crc32c_hw(const uint8_t* p, size_t size, uint32_t crc) {
+    uint64_t crc64 = crc;
+    for(; size >= 8; p += 8, size -= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = static_cast<uint32_t>(crc64);
+    for(; size; p++, size--)
+        crc = _mm_crc32_u8(crc, *p);
+    return crc;
+}
+
+static bool has_crc32c_hw() {
+#   if defined __SSE4_2__ || defined _MSC_VER
+    return true;
+#   else
+    static const bool has_sse42 = __builtin_cpu_supports("sse4.2");
+    return has_sse42;
+#   endif
+}
+#elif defined __ARM_FEATURE_CRC32
+static uint32_t crc32c_hw(const uint8_t* p, size_t size, uint32_t crc) {
+    for(; size >= 8; p += 8, size -= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        crc = __crc32cd(crc, word);
+    }
+    for(; size; p++, size--)
+        crc = __crc32cb(crc, *p);
+    return crc;
+}
+
+static constexpr bool has_crc32c_hw() {
+    return true;
+}
+#endif
+
+uint32_t Eng3D::Hash::crc32c(const void* data, size_t size, uint32_t crc) {
+    const auto* p = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+#if defined __x86_64__ || defined _M_X64 || defined __ARM_FEATURE_CRC32
+    if(has_crc32c_hw())
+        return ~crc32c_hw(p, size, crc);
+#endif
+    return ~crc32c_sw(p, size, crc);
+}
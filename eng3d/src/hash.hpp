@@ -0,0 +1,45 @@
+// Eng3D - General purpouse game engine
+// Copyright (C) 2021, Eng3D contributors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+// Name:
+//      hash.hpp
+//
+// Abstract:
+//      Fast non-cryptographic hashing and checksumming of byte buffers.
+// ----------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Eng3D::Hash {
+    /// @brief 64-bit hash of a buffer (XXH64), suitable for content addressing
+    /// @param data Buffer to hash
+    /// @param size Size of the buffer
+    /// @param seed Initial seed
+    /// @return uint64_t The hash
+    uint64_t xxh64(const void* data, size_t size, uint64_t seed = 0);
+
+    /// @brief CRC32C (Castagnoli) checksum of a buffer, uses the CRC32 instructions of
+    /// SSE4.2 or ARMv8 when the CPU has them
+    /// @param data Buffer to checksum
+    /// @param size Size of the buffer
+    /// @param crc Checksum of the preceding data, to checksum a buffer in pieces
+    /// @return uint32_t The checksum
+    uint32_t crc32c(const void* data, size_t size, uint32_t crc = 0);
+}
@@ -25,10 +25,37 @@
 // ----------------------------------------------------------------------------
 
 #include <filesystem>
+#include <chrono>
+#include <cstring>
+#include <unordered_set>
+#include <unordered_map>
+#include <atomic>
+#include <tbb/parallel_for.h>
+#ifdef E3D_TARGET_WINDOWS
+#   ifndef WINSOCK2_IMPORTED
+#       define WINSOCK2_IMPORTED
+#       include <winsock2.h>
+#   endif
+#   include <windows.h>
+#endif
+#ifdef E3D_TARGET_UNIX
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   ifdef __linux__
+#       include <cerrno>
+#       include <sys/inotify.h>
+#       define E3D_HAS_INOTIFY 1
+#   endif
+#endif
 #include "eng3d/io.hpp"
+#include "eng3d/pak.hpp"
 #include "eng3d/state.hpp"
 #include "eng3d/utils.hpp"
 #include "eng3d/log.hpp"
+#include "eng3d/serializer.hpp"
+#include "eng3d/hash.hpp"
 
 /// @brief Get the abs path object in a safe manner, such as that the access does not
 /// occur on null pointers. Use this function because it also converts slashes
@@ -43,6 +70,79 @@ std::string Eng3D::IO::Asset::Base::get_abs_path() const {
     return path;
 }
 
+//
+// MappedFile
+//
+Eng3D::IO::MappedFile::MappedFile(const std::string& path) {
+#if defined E3D_TARGET_UNIX
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        CXX_THROW(std::runtime_error, Eng3D::translate_format("Can't open file %s", path.c_str()));
+    struct stat st;
+    if(::fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(p != MAP_FAILED) {
+            ptr = static_cast<const uint8_t*>(p);
+            length = st.st_size;
+            mapped = true;
+        }
+    }
+    ::close(fd);
+    if(mapped) return;
+#elif defined E3D_TARGET_WINDOWS
+    file_handle = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file_handle == INVALID_HANDLE_VALUE)
+        CXX_THROW(std::runtime_error, Eng3D::translate_format("Can't open file %s", path.c_str()));
+    LARGE_INTEGER file_size;
+    if(::GetFileSizeEx(file_handle, &file_size) && file_size.QuadPart > 0) {
+        mapping_handle = ::CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(mapping_handle != nullptr) {
+            ptr = static_cast<const uint8_t*>(::MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+            length = static_cast<size_t>(file_size.QuadPart);
+            mapped = ptr != nullptr;
+        }
+    }
+    if(mapped) return;
+#endif
+    // Not mappable (or empty), read it instead
+    std::unique_ptr<FILE, decltype(&std::fclose)> fp(std::fopen(path.c_str(), "rb"), std::fclose);
+    if(fp == nullptr)
+        CXX_THROW(std::runtime_error, Eng3D::translate_format("Can't open file %s", path.c_str()));
+    uint8_t buf[65536];
+    size_t n;
+    while((n = std::fread(buf, 1, sizeof(buf), fp.get())) > 0)
+        buffer.insert(buffer.end(), buf, buf + n);
+    ptr = buffer.data();
+    length = buffer.size();
+}
+
+Eng3D::IO::MappedFile::~MappedFile() {
+#if defined E3D_TARGET_UNIX
+    if(mapped)
+        ::munmap(const_cast<uint8_t*>(ptr), length);
+#elif defined E3D_TARGET_WINDOWS
+    if(mapped)
+        ::UnmapViewOfFile(ptr);
+    if(mapping_handle != nullptr)
+        ::CloseHandle(mapping_handle);
+    if(file_handle != nullptr && file_handle != INVALID_HANDLE_VALUE)
+        ::CloseHandle(file_handle);
+#endif
+}
+
+//
+// Asset::Base
+//
+/// @brief Obtains the contents of the asset without copying them when the asset allows it,
+/// by default they are read onto a buffer owned by the view
+Eng3D::IO::Asset::View Eng3D::IO::Asset::Base::get_view() {
+    this->open();
+    auto buffer = std::make_shared<std::vector<uint8_t>>(this->get_size());
+    this->read(buffer->data(), buffer->size());
+    this->close();
+    return Eng3D::IO::Asset::View(buffer, buffer->data(), buffer->size());
+}
+
 //
 // Asset::File
 //
@@ -85,13 +185,224 @@ size_t Eng3D::IO::Asset::File::get_size(void) const {
     return static_cast<size_t>(size);
 }
 
+/// @brief Maps the file, the mapping is released once the last copy of the view is gone
+Eng3D::IO::Asset::View Eng3D::IO::Asset::File::get_view() {
+    auto file = std::make_shared<const Eng3D::IO::MappedFile>(abs_path);
+    return Eng3D::IO::Asset::View(file, file->data(), file->size());
+}
+
+//
+// Asset::Packed
+//
+Eng3D::IO::Asset::Packed::Packed(std::shared_ptr<const Eng3D::IO::PakFile> _pak, const Eng3D::IO::PakEntry& _entry)
+    : pak{ _pak },
+    entry{ _entry }
+{
+
+}
+
+/// @brief Packed assets have no path on the disk, so they get extracted onto the cache
+/// the first time a caller needs one (i.e libraries that only take paths)
+std::string Eng3D::IO::Asset::Packed::get_abs_path() const {
+    const std::scoped_lock lock(extract_mutex);
+    if(!extracted_path.empty()) return extracted_path;
+    const auto pak_hash = Eng3D::Hash::xxh64(pak->path.data(), pak->path.size());
+    const std::filesystem::path dest = Eng3D::string_format("cache/extracted/%016llx/%s", static_cast<unsigned long long>(pak_hash), entry.path.c_str());
+    std::error_code ec;
+    if(std::filesystem::file_size(dest, ec) != entry.inf_size || std::filesystem::last_write_time(dest, ec) < std::filesystem::last_write_time(pak->path, ec)) {
+        const auto data = pak->read(entry);
+        std::filesystem::create_directories(dest.parent_path());
+        // Other assets (or processes) may be extracting the same file
+#ifdef E3D_TARGET_UNIX
+        const auto tmp_path = dest.string() + Eng3D::string_format(".%ld.%p.tmp", static_cast<long>(::getpid()), static_cast<const void*>(this));
+#else
+        const auto tmp_path = dest.string() + Eng3D::string_format(".%p.tmp", static_cast<const void*>(this));
+#endif
+        std::unique_ptr<FILE, decltype(&std::fclose)> fp(std::fopen(tmp_path.c_str(), "wb"), std::fclose);
+        bool ok = fp != nullptr && std::fwrite(data.data(), 1, data.size(), fp.get()) == data.size() && std::fflush(fp.get()) == 0;
+#ifdef E3D_TARGET_UNIX
+        ok = ok && ::fsync(::fileno(fp.get())) == 0;
+#endif
+        if(fp != nullptr && std::fclose(fp.release()) != 0) ok = false;
+        if(ok) std::filesystem::rename(tmp_path, dest, ec);
+        if(!ok || ec) {
+            std::filesystem::remove(tmp_path, ec);
+            CXX_THROW(std::runtime_error, Eng3D::translate_format("Can't extract %s", path.c_str()));
+        }
+    }
+    extracted_path = dest.string();
+    return extracted_path;
+}
+
+/// @brief Only the extracted path, an asset that was never extracted had nothing loaded
+/// from it's path
+std::string Eng3D::IO::Asset::Packed::peek_abs_path() const {
+    const std::scoped_lock lock(extract_mutex);
+    return extracted_path;
+}
+
+void Eng3D::IO::Asset::Packed::open() {
+    pos = 0;
+    if(entry.codec == Eng3D::Compression::Codec::NONE) {
+        if(!verified) pak->verify(entry);
+        verified = true;
+        data = pak->get_data(entry);
+    } else {
+        inflated = pak->read(entry);
+        data = inflated.data();
+    }
+}
+
+void Eng3D::IO::Asset::Packed::close() {
+    data = nullptr;
+    inflated = std::vector<uint8_t>();
+}
+
+void Eng3D::IO::Asset::Packed::read(void* buf, size_t n) {
+    n = std::min<size_t>(n, entry.inf_size - pos);
+    std::memcpy(buf, data + pos, n);
+    pos += n;
+}
+
+void Eng3D::IO::Asset::Packed::seek(SeekType type, int offset) {
+    int64_t new_pos = offset;
+    if(type == SeekType::CURRENT) new_pos += pos;
+    else if(type == SeekType::END) new_pos += entry.inf_size;
+    pos = static_cast<size_t>(std::clamp<int64_t>(new_pos, 0, entry.inf_size));
+}
+
+size_t Eng3D::IO::Asset::Packed::get_size(void) const {
+    return entry.inf_size;
+}
+
+/// @brief Uncompressed entries are viewed straight from the mapping of the archive, which
+/// is kept alive by the view
+Eng3D::IO::Asset::View Eng3D::IO::Asset::Packed::get_view() {
+    if(entry.codec != Eng3D::Compression::Codec::NONE) {
+        auto buffer = std::make_shared<const std::vector<uint8_t>>(pak->read(entry));
+        return Eng3D::IO::Asset::View(buffer, buffer->data(), buffer->size());
+    }
+    if(!verified) pak->verify(entry);
+    verified = true;
+    return Eng3D::IO::Asset::View(pak, pak->get_data(entry), entry.inf_size);
+}
+
+//
+// Watcher
+//
+Eng3D::IO::Watcher::Watcher() {
+
+}
+
+Eng3D::IO::Watcher::~Watcher() {
+    this->clear();
+}
+
+/// @brief Starts watching a directory, its subdirectories have to be added on their own
+/// @param package_idx Package the directory belongs to, given back on the events
+/// @param dir Directory to watch
+void Eng3D::IO::Watcher::add(size_t package_idx, const std::string& dir) {
+#ifdef E3D_HAS_INOTIFY
+    if(this->fd < 0) {
+        this->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if(this->fd < 0) {
+            Eng3D::Log::warning("watcher", Eng3D::translate_format("Can't initialize inotify: %s", strerror(errno)));
+            return;
+        }
+    }
+    const int wd = inotify_add_watch(this->fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE);
+    if(wd < 0) {
+        Eng3D::Log::warning("watcher", Eng3D::translate_format("Can't watch %s: %s", dir.c_str(), strerror(errno)));
+        return;
+    }
+    this->watches[wd] = std::make_pair(package_idx, dir);
+#endif
+}
+
+/// @brief Stops watching every directory
+void Eng3D::IO::Watcher::clear() {
+#ifdef E3D_HAS_INOTIFY
+    // Closing the instance drops all of its watches
+    if(this->fd >= 0)
+        ::close(this->fd);
+    this->fd = -1;
+#endif
+    this->watches.clear();
+}
+
+/// @brief Obtains the events that happened since the last poll, never blocks
+/// @return std::vector<Eng3D::IO::Watcher::Event> The events, in the order they happened
+std::vector<Eng3D::IO::Watcher::Event> Eng3D::IO::Watcher::poll() {
+    std::vector<Eng3D::IO::Watcher::Event> events;
+#ifdef E3D_HAS_INOTIFY
+    if(this->fd < 0) return events;
+    alignas(struct inotify_event) char buf[4096];
+    ssize_t len;
+    while((len = ::read(this->fd, buf, sizeof(buf))) > 0) {
+        for(ssize_t i = 0; i < len; ) {
+            const auto* ev = reinterpret_cast<const struct inotify_event*>(&buf[i]);
+            i += sizeof(struct inotify_event) + ev->len;
+            if(ev->mask & IN_Q_OVERFLOW) {
+                events.push_back(Eng3D::IO::Watcher::Event{ Eng3D::IO::Watcher::Event::Type::LOST, 0, "", false });
+                continue;
+            }
+            auto it = this->watches.find(ev->wd);
+            if(it == this->watches.end()) continue;
+            if(ev->mask & IN_IGNORED) {
+                this->watches.erase(it); // Directory was removed
+                continue;
+            }
+            if(ev->len == 0) continue;
+
+            Eng3D::IO::Watcher::Event event{};
+            event.package_idx = it->second.first;
+            event.abs_path = it->second.second + "/" + ev->name;
+            event.is_directory = (ev->mask & IN_ISDIR) != 0;
+            if(ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                event.type = Eng3D::IO::Watcher::Event::Type::REMOVED;
+            } else if((ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) || (event.is_directory && (ev->mask & IN_CREATE))) {
+                event.type = Eng3D::IO::Watcher::Event::Type::WRITTEN;
+            } else {
+                continue; // Files that were just created are reported once they're written
+            }
+            events.push_back(event);
+        }
+    }
+#endif
+    return events;
+}
+
 //
 // Package manager
 //
+static int64_t get_mtime(const std::filesystem::path& path) {
+    std::error_code ec;
+    const auto time = std::filesystem::last_write_time(path, ec);
+    return ec ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+/// @brief Hash of the contents of a file, 0 if it can't be read
+static uint64_t hash_file(const std::string& path) {
+    try {
+        const Eng3D::IO::MappedFile file(path);
+        return Eng3D::Hash::xxh64(file.data(), file.size());
+    } catch(const std::runtime_error&) {
+        return 0;
+    }
+}
+
+/// @brief Walks a directory of a package, the files are stat'ed and hashed in parallel and
+/// each subdirectory is walked on its own task
 void Eng3D::IO::PackageManager::recursive_filesystem_walk(Eng3D::IO::Package& package, const std::string& root, const std::string& current) {
+    package.directories.emplace_back(current, get_mtime(current));
+    std::vector<std::string> subdirs;
+    std::vector<std::shared_ptr<Eng3D::IO::Asset::Base>> files;
     // Register paths into our virtual filesystem
-    for(const auto& entry : std::filesystem::recursive_directory_iterator(current)) {
-        if(entry.is_directory()) continue;
+    for(const auto& entry : std::filesystem::directory_iterator(current)) {
+        if(entry.is_directory()) {
+            subdirs.push_back(entry.path().string());
+            continue;
+        }
         auto asset = std::make_shared<Eng3D::IO::Asset::File>();
         asset->path = entry.path().lexically_relative(root).string();
         asset->abs_path = entry.path().string();
@@ -99,8 +410,197 @@ void Eng3D::IO::PackageManager::recursive_filesystem_walk(Eng3D::IO::Package& pa
         std::replace(asset->path.begin(), asset->path.end(), '\\', '/');
         std::replace(asset->abs_path.begin(), asset->abs_path.end(), '\\', '/');
 #endif
+        files.push_back(asset);
+    }
+    tbb::parallel_for(static_cast<size_t>(0), files.size(), [&files](const auto i) {
+        auto& asset = *files[i];
+        std::error_code ec;
+        asset.file_size = std::filesystem::file_size(asset.abs_path, ec);
+        asset.mtime = get_mtime(asset.abs_path);
+        asset.content_hash = hash_file(asset.abs_path);
+    });
+    std::move(files.begin(), files.end(), std::back_inserter(package.assets));
+
+    std::vector<Eng3D::IO::Package> parts(subdirs.size());
+    tbb::parallel_for(static_cast<size_t>(0), subdirs.size(), [&](const auto i) {
+        recursive_filesystem_walk(parts[i], root, subdirs[i]);
+    });
+    for(auto& part : parts) {
+        std::move(part.assets.begin(), part.assets.end(), std::back_inserter(package.assets));
+        std::move(part.directories.begin(), part.directories.end(), std::back_inserter(package.directories));
+    }
+}
+
+//
+// Package manifest cache
+//
+constexpr std::string_view package_cache_path = "cache/packages";
+/// @brief Bumped each time the layout of the cached manifests changes
+constexpr uint32_t package_cache_version = 2;
+
+static std::string get_package_cache_path(const Eng3D::IO::Package& package) {
+    return Eng3D::string_format("%s/%016llx.cache", package_cache_path.data(), static_cast<unsigned long long>(Eng3D::Hash::xxh64(package.abs_path.data(), package.abs_path.size())));
+}
+
+/// @brief (De)-serializes the cached manifest of a package, the assets are stored as
+/// separate arrays of each field
+template<bool is_serialize>
+static void deser_package_cache(Archive& ar, std::string& abs_path, std::vector<std::pair<std::string, int64_t>>& directories, std::vector<std::string>& paths, std::vector<std::string>& abs_paths, std::vector<uint64_t>& sizes, std::vector<int64_t>& mtimes, std::vector<uint64_t>& hashes) {
+    uint32_t version = package_cache_version;
+    ::deser_dynamic<is_serialize>(ar, version);
+    if(version != package_cache_version)
+        CXX_THROW(SerializerException, "Outdated package cache");
+    ::deser_dynamic<is_serialize>(ar, abs_path);
+    ::deser_dynamic<is_serialize>(ar, directories);
+    ::deser_dynamic<is_serialize>(ar, paths);
+    ::deser_dynamic<is_serialize>(ar, abs_paths);
+    ::deser_dynamic<is_serialize>(ar, sizes);
+    ::deser_dynamic<is_serialize>(ar, mtimes);
+    ::deser_dynamic<is_serialize>(ar, hashes);
+}
+
+/// @brief Takes the assets of the package from its cached manifest when none of its
+/// directories changed (adding, removing or renaming a file changes the time of its
+/// directory). Files rewritten in place don't, so the caller still stats every file
+/// and rehashes the changed ones, see refresh_stale_assets
+/// @return bool Whetever the cache was valid
+bool Eng3D::IO::PackageManager::load_package_cache(Eng3D::IO::Package& package) const {
+    const auto cache_path = get_package_cache_path(package);
+    if(!std::filesystem::exists(cache_path)) return false;
+    std::string abs_path;
+    std::vector<std::pair<std::string, int64_t>> directories;
+    std::vector<std::string> paths, abs_paths;
+    std::vector<uint64_t> sizes, hashes;
+    std::vector<int64_t> mtimes;
+    try {
+        Archive ar{};
+        ar.from_file(cache_path);
+        deser_package_cache<false>(ar, abs_path, directories, paths, abs_paths, sizes, mtimes, hashes);
+    } catch(const std::exception& e) {
+        Eng3D::Log::warning("package", Eng3D::translate_format("Discarding package cache %s: %s", cache_path.c_str(), e.what()));
+        return false;
+    }
+    if(abs_path != package.abs_path || abs_paths.size() != paths.size() || sizes.size() != paths.size() || mtimes.size() != paths.size() || hashes.size() != paths.size())
+        return false;
+    for(const auto& [directory, mtime] : directories)
+        if(get_mtime(directory) != mtime)
+            return false;
+
+    package.directories = std::move(directories);
+    package.assets.reserve(paths.size());
+    for(size_t i = 0; i < paths.size(); i++) {
+        auto asset = std::make_shared<Eng3D::IO::Asset::File>();
+        asset->path = std::move(paths[i]);
+        asset->abs_path = std::move(abs_paths[i]);
+        asset->file_size = sizes[i];
+        asset->mtime = mtimes[i];
+        asset->content_hash = hashes[i];
         package.assets.push_back(asset);
     }
+    return true;
+}
+
+void Eng3D::IO::PackageManager::save_package_cache(const Eng3D::IO::Package& package) const {
+    const auto cache_path = get_package_cache_path(package);
+    std::string abs_path = package.abs_path;
+    auto directories = package.directories;
+    std::vector<std::string> paths, abs_paths;
+    std::vector<uint64_t> sizes, hashes;
+    std::vector<int64_t> mtimes;
+    for(const auto& asset : package.assets) {
+        paths.push_back(asset->path);
+        abs_paths.push_back(asset->abs_path);
+        sizes.push_back(asset->file_size);
+        mtimes.push_back(asset->mtime);
+        hashes.push_back(asset->content_hash);
+    }
+    try {
+        std::filesystem::create_directories(package_cache_path);
+        Archive ar{};
+        ar.compression = Eng3D::Compression::Preset::AUTOSAVE;
+        deser_package_cache<true>(ar, abs_path, directories, paths, abs_paths, sizes, mtimes, hashes);
+        ar.to_file(cache_path);
+    } catch(const std::exception& e) {
+        // Not fatal, the package is walked again on the next startup
+        Eng3D::Log::warning("package", Eng3D::translate_format("Can't write package cache %s: %s", cache_path.c_str(), e.what()));
+    }
+}
+
+static std::shared_ptr<Eng3D::IO::Asset::Packed> make_packed_asset(std::shared_ptr<const Eng3D::IO::PakFile> pak, const Eng3D::IO::PakEntry& entry, int64_t mtime) {
+    auto asset = std::make_shared<Eng3D::IO::Asset::Packed>(pak, entry);
+    asset->path = entry.path;
+    asset->abs_path = pak->path + "/" + entry.path;
+    asset->file_size = entry.inf_size;
+    asset->mtime = mtime;
+    asset->content_hash = entry.hash;
+    return asset;
+}
+
+/// @brief Adds the assets of a packed archive onto a package, the loose files of the
+/// package take precedence so mods can override single files of a packed package
+void Eng3D::IO::PackageManager::add_packed_assets(Eng3D::IO::Package& package, const std::string& pak_path) {
+    std::shared_ptr<const Eng3D::IO::PakFile> pak;
+    try {
+        pak = std::make_shared<const Eng3D::IO::PakFile>(pak_path);
+    } catch(const std::exception& e) {
+        Eng3D::Log::error("package", Eng3D::translate_format("Can't open packed archive %s: %s", pak_path.c_str(), e.what()));
+        return;
+    }
+    std::unordered_set<std::string_view> loose_paths;
+    for(const auto& asset : package.assets)
+        loose_paths.insert(asset->path);
+    const auto mtime = get_mtime(pak_path);
+    size_t n_overriden = 0;
+    for(const auto& entry : pak->entries) {
+        if(loose_paths.contains(entry.path)) {
+            n_overriden++;
+            continue;
+        }
+        package.assets.push_back(make_packed_asset(pak, entry, mtime));
+    }
+    package.pak = pak;
+    Eng3D::Log::debug("package", Eng3D::translate_format("Packed archive %s has %zu assets, %zu overriden by loose files", pak_path.c_str(), pak->entries.size(), n_overriden));
+}
+
+/// @brief Rewriting a file doesn't change the time of its directory, so the size and time of
+/// each file of a cached manifest is checked, the files that changed are hashed again
+/// @return size_t Number of files that changed
+static size_t refresh_stale_assets(Eng3D::IO::Package& package) {
+    std::atomic<size_t> n_stale = 0;
+    tbb::parallel_for(static_cast<size_t>(0), package.assets.size(), [&package, &n_stale](const auto i) {
+        auto& asset = *package.assets[i];
+        std::error_code ec;
+        const auto file_size = std::filesystem::file_size(asset.abs_path, ec);
+        const auto mtime = get_mtime(asset.abs_path);
+        if(file_size == asset.file_size && mtime == asset.mtime) return;
+        asset.file_size = file_size;
+        asset.mtime = mtime;
+        asset.content_hash = hash_file(asset.abs_path);
+        n_stale++;
+    });
+    return n_stale;
+}
+
+/// @brief Obtains the assets of a package, from the cached manifest when none of its
+/// directories changed or by walking it otherwise, and then from its packed archive
+/// (a .pak file next to the directory), if any. A cached package still costs a stat of
+/// each file, but only the files that changed are read and hashed
+void Eng3D::IO::PackageManager::scan_package(Eng3D::IO::Package& package) {
+    if(std::filesystem::is_directory(package.abs_path)) {
+        package.from_cache = this->load_package_cache(package);
+        if(package.from_cache) {
+            if(refresh_stale_assets(package))
+                this->save_package_cache(package);
+        } else {
+            package.assets.clear();
+            package.directories.clear();
+            recursive_filesystem_walk(package, package.abs_path, package.abs_path);
+            this->save_package_cache(package);
+        }
+    }
+    const auto pak_path = package.abs_path + ".pak";
+    if(std::filesystem::is_regular_file(pak_path))
+        this->add_packed_assets(package, pak_path);
 }
 
 static inline std::string get_full_path() {
@@ -121,15 +621,22 @@ static inline std::string get_full_path() {
 Eng3D::IO::PackageManager::PackageManager(Eng3D::State& _s, const std::vector<std::string>& pkg_paths)
     : s{ _s }
 {
+    const auto start_time = std::chrono::steady_clock::now();
     if(pkg_paths.empty()) {
         const std::string asset_path = get_full_path();
         // All folders inside mods/
         for(const auto& entry : std::filesystem::directory_iterator(asset_path)) {
-            if(!entry.is_directory()) continue;
+            auto path = entry.path();
+            // Packed archives without a directory of the same name are packages on their own
+            if(path.extension() == ".pak") {
+                path.replace_extension();
+                if(std::filesystem::is_directory(path)) continue;
+            } else if(!entry.is_directory()) {
+                continue;
+            }
             Eng3D::IO::Package package{};
-            package.name = entry.path().lexically_relative(asset_path).string(); // Relative (for nicer names)
-            package.abs_path = entry.path().string(); // Absolute
-            recursive_filesystem_walk(package, entry.path().string(), entry.path().string());
+            package.name = path.lexically_relative(asset_path).string(); // Relative (for nicer names)
+            package.abs_path = path.string(); // Absolute
             this->packages.push_back(package);
         }
     } else {
@@ -138,20 +645,312 @@ Eng3D::IO::PackageManager::PackageManager(Eng3D::State& _s, const std::vector<st
             Eng3D::IO::Package package{};
             package.name = entry;
             package.abs_path = entry;
-            recursive_filesystem_walk(package, entry, entry);
+            // Either the directory or the packed archive of the package can be given
+            if(std::filesystem::path(entry).extension() == ".pak")
+                package.abs_path = std::filesystem::path(entry).replace_extension().string();
             this->packages.push_back(package);
         }
     }
+    tbb::parallel_for(static_cast<size_t>(0), this->packages.size(), [this](const auto i) {
+        this->scan_package(this->packages[i]);
+    });
+    const auto n_cached = std::count_if(this->packages.begin(), this->packages.end(), [](const auto& package) {
+        return package.from_cache;
+    });
+    const auto walk_time = std::chrono::steady_clock::now();
+    this->build_index();
+    const auto index_time = std::chrono::steady_clock::now();
+    Eng3D::Log::debug("package", Eng3D::translate_format("Found %zu paths on %zu packages (%zu cached) in %lldms, indexed in %lldms", this->path_index.size(), this->packages.size(), static_cast<size_t>(n_cached),
+        static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(walk_time - start_time).count()),
+        static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(index_time - walk_time).count())));
+
+    // Assets with the same contents under different paths are loaded once by the managers
+    std::unordered_map<uint64_t, uint64_t> unique_contents;
+    size_t n_duplicates = 0;
+    uint64_t duplicate_size = 0;
+    for(const auto& [path, assets] : this->path_index) {
+        const auto& asset = *assets.front();
+        if(!asset.content_hash) continue;
+        if(!unique_contents.emplace(asset.content_hash, asset.file_size).second) {
+            n_duplicates++;
+            duplicate_size += asset.file_size;
+        }
+    }
+    if(n_duplicates)
+        Eng3D::Log::debug("package", Eng3D::translate_format("%zu paths are duplicates of another asset, %.2fMB won't be read nor decoded twice", n_duplicates, static_cast<double>(duplicate_size) / (1024.0 * 1024.0)));
+}
+
+/// @brief Maps each path onto the assets that provide it, a path provided by multiple
+/// packages keeps the order of the packages (so the first one is the one that wins)
+void Eng3D::IO::PackageManager::build_index() {
+    size_t n_assets = 0;
+    for(const auto& package : this->packages)
+        n_assets += package.assets.size();
+    this->path_index.clear();
+    this->path_index.reserve(n_assets);
+    this->sorted_assets.clear();
+    this->sorted_assets.reserve(n_assets);
+    for(auto& package : this->packages) {
+        package.asset_idx.clear();
+        package.asset_idx.reserve(package.assets.size());
+        for(size_t i = 0; i < package.assets.size(); i++) {
+            const auto& asset = package.assets[i];
+            package.asset_idx[asset->path] = i;
+            this->path_index[asset->path].push_back(asset);
+            this->sorted_assets.push_back(asset);
+        }
+    }
+    std::stable_sort(this->sorted_assets.begin(), this->sorted_assets.end(), [](const auto& a, const auto& b) {
+        return a->path < b->path;
+    });
+}
+
+/// @brief Updates the index entries of a single path after the assets of the packages
+/// providing it changed
+/// @param path The path to update
+void Eng3D::IO::PackageManager::reindex(const std::string& path) {
+    std::vector<std::shared_ptr<Eng3D::IO::Asset::Base>> list;
+    for(const auto& package : this->packages)
+        if(auto it = package.asset_idx.find(path); it != package.asset_idx.end())
+            list.push_back(package.assets[it->second]);
+
+    auto first = std::lower_bound(this->sorted_assets.begin(), this->sorted_assets.end(), path, [](const auto& asset, const std::string& value) {
+        return asset->path < value;
+    });
+    auto last = first;
+    while(last != this->sorted_assets.end() && (*last)->path == path)
+        last++;
+    this->sorted_assets.insert(this->sorted_assets.erase(first, last), list.begin(), list.end());
+
+    if(list.empty())
+        this->path_index.erase(path);
+    else
+        this->path_index[path] = std::move(list);
+}
+
+/// @brief Starts (or stops) watching the directories of the packages, the changes are
+/// then applied by calling update
+/// @param enable Whetever to watch the packages
+void Eng3D::IO::PackageManager::watch(bool enable) {
+    this->watcher.clear();
+    if(!enable) return;
+    for(size_t i = 0; i < this->packages.size(); i++)
+        for(const auto& [dir, mtime] : this->packages[i].directories)
+            this->watcher.add(i, dir);
+    Eng3D::Log::debug("package", Eng3D::translate_format("Watching the packages for changes, %zu packages", this->packages.size()));
+}
+
+static std::string get_package_path(const Eng3D::IO::Package& package, const std::string& abs_path) {
+    auto path = std::filesystem::path(abs_path).lexically_relative(package.abs_path).string();
+#ifdef E3D_TARGET_WINDOWS
+    std::replace(path.begin(), path.end(), '\\', '/');
+#endif
+    return path;
+}
+
+/// @brief Sets the asset of a path of the package, replacing the one it had (a packed one
+/// included, since loose files override them)
+static void set_package_asset(Eng3D::IO::Package& package, std::shared_ptr<Eng3D::IO::Asset::Base> asset) {
+    const auto [it, inserted] = package.asset_idx.try_emplace(asset->path, package.assets.size());
+    if(inserted)
+        package.assets.push_back(asset);
+    else
+        package.assets[it->second] = asset;
+}
+
+/// @brief Unregisters a loose file that was removed, the copy of the packed archive of the
+/// package (if any) is provided again in its place
+static void remove_loose_asset(Eng3D::IO::Package& package, const std::string& path) {
+    if(auto it = package.asset_idx.find(path); it != package.asset_idx.end()) {
+        // The order of the assets of a package doesn't matter, the last one takes the place
+        const auto idx = it->second;
+        package.asset_idx.erase(it);
+        if(idx + 1 != package.assets.size()) {
+            package.assets[idx] = std::move(package.assets.back());
+            package.asset_idx[package.assets[idx]->path] = idx;
+        }
+        package.assets.pop_back();
+    }
+    if(package.pak.get() == nullptr) return;
+    if(const auto* entry = package.pak->find(path); entry != nullptr)
+        set_package_asset(package, make_packed_asset(package.pak, *entry, get_mtime(package.pak->path)));
+}
+
+/// @brief Range of the sorted assets whose path starts with the given prefix
+template<typename T>
+static auto get_prefix_range(T& sorted_assets, std::string_view prefix) {
+    auto first = std::lower_bound(sorted_assets.begin(), sorted_assets.end(), prefix, [](const auto& asset, std::string_view value) {
+        return std::string_view(asset->path) < value;
+    });
+    auto last = first;
+    while(last != sorted_assets.end() && (*last)->path.starts_with(prefix))
+        last++;
+    return std::make_pair(first, last);
+}
+
+/// @brief Applies the changes reported by the watcher onto the packages, only the index
+/// entries of the paths that changed are updated (unless the watcher lost track of the
+/// changes, in which case the packages are walked again)
+/// @return std::vector<Eng3D::IO::AssetChange> The paths that changed, with the asset now provided for each
+std::vector<Eng3D::IO::AssetChange> Eng3D::IO::PackageManager::update() {
+    std::vector<Eng3D::IO::AssetChange> changes;
+    const auto events = this->watcher.poll();
+    if(events.empty()) return changes;
+    const auto start_time = std::chrono::steady_clock::now();
+
+    // Remember the asset that each path resolved to before anything is applied
+    std::unordered_map<std::string, size_t> change_idx;
+    const auto touch = [this, &changes, &change_idx](const std::string& path) {
+        if(change_idx.contains(path)) return;
+        change_idx[path] = changes.size();
+        Eng3D::IO::AssetChange change{};
+        change.path = path;
+        if(auto it = this->path_index.find(path); it != this->path_index.end())
+            change.prev = it->second.front();
+        changes.push_back(change);
+    };
+
+    bool lost = false;
+    std::vector<std::shared_ptr<Eng3D::IO::Asset::Base>> written;
+    for(const auto& event : events) {
+        if(event.type == Eng3D::IO::Watcher::Event::Type::LOST) {
+            lost = true;
+            continue;
+        }
+        auto& package = this->packages[event.package_idx];
+        const auto path = get_package_path(package, event.abs_path);
+        if(event.is_directory && event.type == Eng3D::IO::Watcher::Event::Type::WRITTEN) {
+            Eng3D::IO::Package part{};
+            try {
+                recursive_filesystem_walk(part, package.abs_path, event.abs_path);
+            } catch(const std::filesystem::filesystem_error&) {
+                continue; // Removed right away, a later event takes care of it
+            }
+            for(const auto& [dir, mtime] : part.directories)
+                this->watcher.add(event.package_idx, dir);
+            // Already stat'ed and hashed by the walk
+            for(const auto& asset : part.assets) {
+                touch(asset->path);
+                set_package_asset(package, asset);
+            }
+            std::move(part.directories.begin(), part.directories.end(), std::back_inserter(package.directories));
+        } else if(event.is_directory) {
+            // Everything that was under the directory is gone, the sorted assets are only
+            // updated after all the events are applied, the paths added since then are changes
+            const auto prefix = path + "/";
+            std::unordered_set<std::string> removed;
+            const auto add_removed = [&package, &prefix, &removed](const std::string& asset_path) {
+                if(!asset_path.starts_with(prefix)) return;
+                const auto idx = package.asset_idx.find(asset_path);
+                if(idx == package.asset_idx.end()) return;
+                if(dynamic_cast<const Eng3D::IO::Asset::File*>(package.assets[idx->second].get()) != nullptr)
+                    removed.insert(asset_path);
+            };
+            const auto [first, last] = get_prefix_range(this->sorted_assets, prefix);
+            for(auto it = first; it != last; it++)
+                add_removed((*it)->path);
+            for(const auto& change : changes)
+                add_removed(change.path);
+            for(const auto& removed_path : removed) {
+                touch(removed_path);
+                remove_loose_asset(package, removed_path);
+            }
+            std::erase_if(package.directories, [&event](const auto& e) {
+                return e.first == event.abs_path || e.first.starts_with(event.abs_path + "/");
+            });
+        } else {
+            touch(path);
+            if(event.type == Eng3D::IO::Watcher::Event::Type::WRITTEN) {
+                auto asset = std::make_shared<Eng3D::IO::Asset::File>();
+                asset->path = path;
+                asset->abs_path = event.abs_path;
+                set_package_asset(package, asset);
+                written.push_back(asset);
+            } else {
+                remove_loose_asset(package, path);
+            }
+        }
+    }
+    // Files written are stat'ed and hashed on the workers, all at once
+    if(!lost) tbb::parallel_for(static_cast<size_t>(0), written.size(), [&written](const auto i) {
+        auto& asset = *written[i];
+        std::error_code ec;
+        asset.file_size = std::filesystem::file_size(asset.abs_path, ec);
+        asset.mtime = get_mtime(asset.abs_path);
+        asset.content_hash = hash_file(asset.abs_path);
+    });
+
+    if(lost) {
+        // Walk everything again and report the paths whose asset isn't the same file anymore
+        Eng3D::Log::warning("package", "Lost track of the changes of the packages, walking them again");
+        for(const auto& [path, list] : this->path_index)
+            touch(path);
+        for(auto& package : this->packages) {
+            package.assets.clear();
+            package.directories.clear();
+            package.pak.reset();
+            if(std::filesystem::is_directory(package.abs_path))
+                recursive_filesystem_walk(package, package.abs_path, package.abs_path);
+            const auto pak_path = package.abs_path + ".pak";
+            if(std::filesystem::is_regular_file(pak_path))
+                this->add_packed_assets(package, pak_path);
+        }
+        this->build_index();
+        this->watch();
+        for(const auto& [path, list] : this->path_index)
+            touch(path);
+    } else {
+        for(const auto& change : changes)
+            this->reindex(change.path);
+    }
+
+    for(auto& change : changes) {
+        if(auto it = this->path_index.find(change.path); it != this->path_index.end())
+            change.asset = it->second.front();
+    }
+    // Drop temporary files that came and went, and after walking again the files that didn't change
+    std::erase_if(changes, [lost](const auto& change) {
+        if(change.prev.get() == nullptr || change.asset.get() == nullptr)
+            return change.prev.get() == change.asset.get();
+        return lost && change.prev->abs_path == change.asset->abs_path && change.prev->mtime == change.asset->mtime && change.prev->file_size == change.asset->file_size;
+    });
+    const auto end_time = std::chrono::steady_clock::now();
+    Eng3D::Log::debug("package", Eng3D::translate_format("Applied %zu changes of the packages in %lldus", changes.size(),
+        static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count())));
+    return changes;
+}
+
+/// @brief Matches a path against a glob pattern, where '?' matches any character, '*' any
+/// run of characters within a directory and '**' any run of characters, slashes included
+static bool glob_match(std::string_view pattern, std::string_view path) {
+    while(!pattern.empty()) {
+        if(pattern[0] == '*') {
+            const bool crosses = pattern.size() > 1 && pattern[1] == '*';
+            pattern.remove_prefix(crosses ? 2 : 1);
+            for(size_t i = 0; i <= path.size(); i++) {
+                if(glob_match(pattern, path.substr(i)))
+                    return true;
+                if(i < path.size() && path[i] == '/' && !crosses)
+                    break;
+            }
+            return false;
+        }
+        if(path.empty() || (path[0] == '/' && pattern[0] == '?') || (pattern[0] != '?' && pattern[0] != path[0]))
+            return false;
+        pattern.remove_prefix(1);
+        path.remove_prefix(1);
+    }
+    return path.empty();
 }
 
 /// @brief Obtaining an unique asset means the "first-found" policy applies
 /// @param path The path to obtain
 /// @return std::shared_ptr<Eng3D::IO::Asset::Base> Obtained asset object
 std::shared_ptr<Eng3D::IO::Asset::Base> Eng3D::IO::PackageManager::get_unique(const Eng3D::IO::Path& path) {
-    std::vector<std::shared_ptr<Eng3D::IO::Asset::Base>> list = this->get_multiple(path);
-    if(list.empty())
+    auto it = this->path_index.find(path.str);
+    if(it == this->path_index.end())
         return std::shared_ptr<Eng3D::IO::Asset::Base>(nullptr);
-    return list.at(0);
+    return it->second.front();
 }
 
 /// @brief Obtains multiple assets iff they share a common path (useful for concating
@@ -159,26 +958,55 @@ std::shared_ptr<Eng3D::IO::Asset::Base> Eng3D::IO::PackageManager::get_unique(co
 /// @param path
 /// @return std::vector<std::shared_ptr<Eng3D::IO::Asset::Base>>
 std::vector<std::shared_ptr<Eng3D::IO::Asset::Base>> Eng3D::IO::PackageManager::get_multiple(const Eng3D::IO::Path& path) {
-    std::vector<std::shared_ptr<Eng3D::IO::Asset::Base>> list;
-    for(const auto& package : this->packages)
-        for(const auto& asset : package.assets)
-            if(asset->path == path.str)
-                list.push_back(asset);
-    return list;
+    auto it = this->path_index.find(path.str);
+    if(it == this->path_index.end())
+        return std::vector<std::shared_ptr<Eng3D::IO::Asset::Base>>();
+    return it->second;
 }
 
 /// @brief Obtains all assets starting with a given prefix
 /// @param prefix The prefix to check for
 /// @return std::vector<std::shared_ptr<Eng3D::IO::Asset::Base>>
 std::vector<std::shared_ptr<Eng3D::IO::Asset::Base>> Eng3D::IO::PackageManager::get_multiple_prefix(const Eng3D::IO::Path& prefix) {
+    const auto [first, last] = get_prefix_range(this->sorted_assets, prefix.str);
+    return std::vector<std::shared_ptr<Eng3D::IO::Asset::Base>>(first, last);
+}
+
+/// @brief Obtains all assets matching a glob pattern, such as "gfx/flags/*.png" or "lua/**.lua"
+/// @param pattern The pattern to match, see glob_match
+/// @return std::vector<std::shared_ptr<Eng3D::IO::Asset::Base>>
+std::vector<std::shared_ptr<Eng3D::IO::Asset::Base>> Eng3D::IO::PackageManager::get_multiple_glob(const Eng3D::IO::Path& pattern) {
+    // Only the assets under the literal part of the pattern need to be checked
+    const std::string_view pattern_view = pattern.str;
+    const auto [first, last] = get_prefix_range(this->sorted_assets, pattern_view.substr(0, pattern_view.find_first_of("*?")));
     std::vector<std::shared_ptr<Eng3D::IO::Asset::Base>> list;
-    for(const auto& package : this->packages)
-        for(const auto& asset : package.assets)
-            if(asset->path.substr(0, prefix.str.length()) == prefix.str)
-                list.push_back(asset);
+    for(auto it = first; it != last; it++)
+        if(glob_match(pattern_view, (*it)->path))
+            list.push_back(*it);
     return list;
 }
 
+/// @brief Lists the entries right under a directory (of all the packages), directories
+/// have a trailing slash
+/// @param path The directory to list, an empty path lists the root
+/// @return std::vector<std::string> Names of the entries, sorted
+std::vector<std::string> Eng3D::IO::PackageManager::list_directory(const Eng3D::IO::Path& path) const {
+    std::string prefix = path.str;
+    if(!prefix.empty() && prefix.back() != '/')
+        prefix.push_back('/');
+    const auto [first, last] = get_prefix_range(this->sorted_assets, prefix);
+    std::vector<std::string> entries;
+    for(auto it = first; it != last; it++) {
+        std::string_view name = std::string_view((*it)->path).substr(prefix.size());
+        if(const auto slash = name.find('/'); slash != std::string_view::npos)
+            name = name.substr(0, slash + 1);
+        // Entries of the same directory are contiguous, so only the last one needs to be checked
+        if(entries.empty() || entries.back() != name)
+            entries.emplace_back(name);
+    }
+    return entries;
+}
+
 /// @brief Obtain all the paths that are currently under the management of a package, that is
 /// return the absolute root directory of all packages
 /// @return std::vector<std::string> The list of paths
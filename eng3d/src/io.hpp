@@ -29,12 +29,23 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <atomic>
+#include <mutex>
 #include <algorithm>
+#include <unordered_map>
+#include <cstdint>
+#include <span>
+#include <string_view>
 
 namespace Eng3D {
     class State;
 }
 
+namespace Eng3D::IO {
+    class PakFile;
+    struct PakEntry;
+}
+
 /// @brief Implements the I/O functions for interacting with assets, please note that
 /// this is however outdated because <filesystem> now exists, but we are
 /// given more flexibility if we roll our own implementation to make a "mini Virtual-Filesystem"
@@ -74,32 +85,134 @@ namespace Eng3D::IO {
         CURRENT,
     };
 
+    /// @brief A read-only view of a whole file, mapped onto memory where the platform
+    /// allows it and read onto memory otherwise
+    class MappedFile {
+    public:
+        MappedFile(const std::string& path);
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        inline const uint8_t* data() const {
+            return ptr;
+        }
+
+        inline size_t size() const {
+            return length;
+        }
+    private:
+        const uint8_t* ptr = nullptr;
+        size_t length = 0;
+        bool mapped = false;
+        std::vector<uint8_t> buffer; // Contents, when the file isn't mapped
+#ifdef E3D_TARGET_WINDOWS
+        void* file_handle = nullptr;
+        void* mapping_handle = nullptr;
+#endif
+    };
+
+    /// @brief Watches directories for files being written or removed, through inotify where
+    /// available (elsewhere nothing is ever reported)
+    class Watcher {
+    public:
+        /// @brief A file or directory of a watched directory that was written or removed
+        struct Event {
+            enum class Type {
+                WRITTEN,
+                REMOVED,
+                LOST, // Events were dropped, everything has to be checked again
+            } type;
+            size_t package_idx;
+            std::string abs_path;
+            bool is_directory;
+        };
+
+        Watcher();
+        ~Watcher();
+        Watcher(const Watcher&) = delete;
+        Watcher& operator=(const Watcher&) = delete;
+        void add(size_t package_idx, const std::string& dir);
+        void clear();
+        std::vector<Event> poll();
+
+        inline bool empty() const {
+            return watches.empty();
+        }
+    private:
+        int fd = -1;
+        std::unordered_map<int, std::pair<size_t, std::string>> watches; // Package and directory of each watch
+    };
+
     namespace Asset {
+        /// @brief Read-only contents of an asset, the memory stays valid for as long as the
+        /// view (or any copy of it) lives
+        class View {
+        public:
+            View() = default;
+            View(std::shared_ptr<const void> _owner, const uint8_t* _ptr, size_t _length)
+                : owner{ _owner },
+                ptr{ _ptr },
+                length{ _length }
+            {
+
+            }
+            ~View() = default;
+
+            inline std::span<const uint8_t> data() const {
+                return std::span<const uint8_t>(ptr, length);
+            }
+
+            inline std::string_view str() const {
+                return std::string_view(reinterpret_cast<const char*>(ptr), length);
+            }
+
+            inline size_t size() const {
+                return length;
+            }
+
+            inline bool empty() const {
+                return length == 0;
+            }
+        private:
+            std::shared_ptr<const void> owner; // Mapping or buffer holding the contents
+            const uint8_t* ptr = nullptr;
+            size_t length = 0;
+        };
+
         class Base {
         public:
             Base() = default;
-            ~Base() = default;
-            std::string get_abs_path() const;
+            virtual ~Base() = default;
+            virtual std::string get_abs_path() const;
+            /// @brief Path the asset was (or would be) loaded from by the managers, without
+            /// extracting it, empty when the asset has no path yet
+            virtual std::string peek_abs_path() const { return this->get_abs_path(); };
             virtual void open() {};
             virtual void close() {};
             virtual void read(void*, size_t) {};
             virtual void write(const void*, size_t) {};
             virtual void seek(Eng3D::IO::SeekType, int) {};
             virtual size_t get_size(void) const { return 0; };
+            virtual Asset::View get_view();
 
             std::string path;
             std::string abs_path;
+            /// @brief Size and modification time when the package was scanned
+            uint64_t file_size = 0;
+            int64_t mtime = 0;
+            /// @brief xxh64 of the contents (0 if unknown), assets with the same contents are
+            /// loaded only once by the managers
+            uint64_t content_hash = 0;
 
-            /// @brief Read the entire file into a string
+            /// @brief Read the entire file into a string, prefer get_view when a copy isn't needed
             /// @return std::string The file contents
             inline std::string read_all(void) {
-                this->open();
-                const size_t size = this->get_size();
+                const auto view = this->get_view();
                 std::string str;
-                str.resize(size + 1, ' ');
-                this->read(&str[0], size);
-                str[size] = '\0';
-                this->close();
+                str.reserve(view.size() + 1);
+                str.append(view.str());
+                str.push_back('\0');
                 return str;
             }
         };
@@ -117,6 +230,33 @@ namespace Eng3D::IO {
             virtual void write(const void* buf, size_t n);
             virtual void seek(Eng3D::IO::SeekType type, int offset);
             virtual size_t get_size(void) const;
+            virtual Asset::View get_view();
+        };
+
+        /// @brief An asset stored inside a packed archive, reads are served straight from the
+        /// mapping of the archive (or from a buffer, when the asset is compressed)
+        class Packed : public Asset::Base {
+        public:
+            Packed(std::shared_ptr<const Eng3D::IO::PakFile> _pak, const Eng3D::IO::PakEntry& _entry);
+            ~Packed() = default;
+            virtual std::string get_abs_path() const;
+            virtual std::string peek_abs_path() const;
+            virtual void open();
+            virtual void close();
+            virtual void read(void* buf, size_t n);
+            virtual void seek(Eng3D::IO::SeekType type, int offset);
+            virtual size_t get_size(void) const;
+            virtual Asset::View get_view();
+
+            std::shared_ptr<const Eng3D::IO::PakFile> pak;
+            const Eng3D::IO::PakEntry& entry;
+        private:
+            std::vector<uint8_t> inflated;
+            std::atomic<bool> verified = false; // Checksum of an uncompressed entry was checked
+            const uint8_t* data = nullptr;
+            size_t pos = 0;
+            mutable std::mutex extract_mutex; // Guards extracted_path, threads may ask for it at once
+            mutable std::string extracted_path;
         };
     };
 
@@ -138,8 +278,26 @@ namespace Eng3D::IO {
         std::string name;
         std::string abs_path; // Absolute path of this package root
         std::vector<std::shared_ptr<Eng3D::IO::Asset::Base>> assets;
+        /// @brief Position of each path on assets, rebuilt with PackageManager::build_index
+        std::unordered_map<std::string, size_t> asset_idx;
         std::string user_abs_path; // Absolute path for the user files
         std::vector<std::shared_ptr<Eng3D::IO::Asset::Base>> user_assets;
+        /// @brief Every directory of the package with its modification time, as long as none of
+        /// them changes the list of assets stays the same
+        std::vector<std::pair<std::string, int64_t>> directories;
+        /// @brief Whetever the assets were taken from the cached manifest instead of walking
+        bool from_cache = false;
+        /// @brief Packed archive of the package, if any
+        std::shared_ptr<const Eng3D::IO::PakFile> pak;
+    };
+
+    /// @brief An asset path whose contents changed, reported by PackageManager::update
+    struct AssetChange {
+        std::string path;
+        /// @brief Asset that used to be returned for the path, null when it's a new path
+        std::shared_ptr<Eng3D::IO::Asset::Base> prev;
+        /// @brief Asset now returned for the path, null when it was removed from every package
+        std::shared_ptr<Eng3D::IO::Asset::Base> asset;
     };
 
     class PackageManager {
@@ -149,11 +307,29 @@ namespace Eng3D::IO {
         PackageManager(Eng3D::State& s, const std::vector<std::string>& pkg_paths);
         ~PackageManager() = default;
         void recursive_filesystem_walk(Eng3D::IO::Package& package, const std::string& root, const std::string& current);
+        void scan_package(Eng3D::IO::Package& package);
+        void add_packed_assets(Eng3D::IO::Package& package, const std::string& pak_path);
+        bool load_package_cache(Eng3D::IO::Package& package) const;
+        void save_package_cache(const Eng3D::IO::Package& package) const;
         std::shared_ptr<Eng3D::IO::Asset::Base> get_unique(const Eng3D::IO::Path& path);
         std::vector<std::shared_ptr<Eng3D::IO::Asset::Base>> get_multiple(const Eng3D::IO::Path& path);
         std::vector<std::shared_ptr<Eng3D::IO::Asset::Base>> get_multiple_prefix(const Eng3D::IO::Path& path);
+        std::vector<std::shared_ptr<Eng3D::IO::Asset::Base>> get_multiple_glob(const Eng3D::IO::Path& pattern);
+        std::vector<std::string> list_directory(const Eng3D::IO::Path& path) const;
         std::vector<std::string> get_paths(void) const;
+        void build_index();
+        void reindex(const std::string& path);
+        void watch(bool enable = true);
+        std::vector<Eng3D::IO::AssetChange> update();
 
         std::vector<Package> packages;
+        /// @brief Assets of each path, in the order of the packages, rebuilt with build_index
+        /// whenever the assets of the packages change
+        std::unordered_map<std::string, std::vector<std::shared_ptr<Eng3D::IO::Asset::Base>>> path_index;
+        /// @brief All the assets sorted by path (and by package for the same path), the assets
+        /// under a given prefix are a contiguous range of it
+        std::vector<std::shared_ptr<Eng3D::IO::Asset::Base>> sorted_assets;
+        /// @brief Watches the directories of the packages while hot reloading is enabled
+        Eng3D::IO::Watcher watcher;
     };
 };
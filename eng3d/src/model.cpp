@@ -158,11 +158,7 @@ Eng3D::ModelManager::ModelManager(Eng3D::State& _s)
 
 }
 
-std::shared_ptr<Eng3D::Model> Eng3D::ModelManager::load(const std::string& path) {
-    auto it = models.find(path);
-    if(it != models.cend())
-        return (*it).second;
-
+static std::shared_ptr<Eng3D::Model> import_model(const std::string& path) {
     // Wavefront OBJ loader
     std::shared_ptr<Eng3D::Model> model;
     try {
@@ -181,10 +177,35 @@ std::shared_ptr<Eng3D::Model> Eng3D::ModelManager::load(const std::string& path)
         // Make a dummy model
         model = std::make_shared<Eng3D::Model>();
     }
+    return model;
+}
+
+std::shared_ptr<Eng3D::Model> Eng3D::ModelManager::load(const std::string& path) {
+    auto it = models.find(path);
+    if(it != models.cend())
+        return (*it).second;
+
+    auto model = import_model(path);
     models[path] = model;
     return model;
 }
 
+/// @brief Imports again the model loaded from a file which changed, the model keeps its
+/// handle so whoever holds it draws the new meshes right away
+/// @param path Path the model was loaded from
+/// @param new_path Path to load it from now on, see TextureManager::reload
+/// @return size_t Number of models reloaded
+size_t Eng3D::ModelManager::reload(const std::string& path, const std::string& new_path) {
+    auto node = models.extract(path);
+    if(node.empty()) return 0;
+    node.mapped()->simple_models = std::move(import_model(new_path)->simple_models);
+    // Keep the old key if a model was already loaded from the new path
+    if(!models.contains(new_path))
+        node.key() = new_path;
+    models.insert(std::move(node));
+    return 1;
+}
+
 std::shared_ptr<Eng3D::Model> Eng3D::ModelManager::load(std::shared_ptr<Eng3D::IO::Asset::Base> asset) {
     return this->load(asset.get() != nullptr ? asset->get_abs_path() : "");
 }
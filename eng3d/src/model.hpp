@@ -92,5 +92,11 @@ namespace Eng3D {
         ~ModelManager() = default;
         std::shared_ptr<Eng3D::Model> load(const std::string& path);
         std::shared_ptr<Eng3D::Model> load(std::shared_ptr<Eng3D::IO::Asset::Base> asset);
+        size_t reload(const std::string& path, const std::string& new_path);
+
+        /// @brief Whetever a model was loaded from the path
+        inline bool is_loaded(const std::string& path) const {
+            return models.contains(path);
+        }
     };
 }
\ No newline at end of file
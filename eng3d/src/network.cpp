@@ -63,6 +63,7 @@
 #include "eng3d/network.hpp"
 #include "eng3d/log.hpp"
 #include "eng3d/utils.hpp"
+#include "eng3d/hash.hpp"
 
 constexpr static int max_tries = 10; // 10 * 100ms = 10 seconds
 constexpr static int tries_ms = 100;
@@ -160,6 +161,8 @@ void Eng3D::Networking::Packet::send() {
     const uint16_t net_size = htons(n_data);
     stream.send(&net_size, sizeof(net_size), pred);
     stream.send(buffer.data(), n_data, pred);
+    const uint32_t net_checksum = htonl(Eng3D::Hash::crc32c(buffer.data(), n_data));
+    stream.send(&net_checksum, sizeof(net_checksum), pred);
     const uint16_t eof_marker = htons(0xE0F);
     stream.send(&eof_marker, sizeof(eof_marker), pred);
 }
@@ -174,10 +177,14 @@ void Eng3D::Networking::Packet::recv() {
     n_data = (size_t)ntohs(net_size);
     buffer.resize(n_data + 1);
     stream.recv(buffer.data(), n_data, pred);
+    uint32_t net_checksum;
+    stream.recv(&net_checksum, sizeof(net_checksum), pred);
     uint16_t eof_marker;
     stream.recv(&eof_marker, sizeof(eof_marker), pred);
     if(ntohs(eof_marker) != 0xE0F)
         CXX_THROW(Eng3D::Networking::SocketException, translate("Packet with invalid end marker"));
+    if(ntohl(net_checksum) != Eng3D::Hash::crc32c(buffer.data(), n_data))
+        CXX_THROW(Eng3D::Networking::SocketException, translate("Packet checksum mismatch"));
 }
 
 //
@@ -0,0 +1,291 @@
+// Eng3D - General purpouse game engine
+// Copyright (C) 2021, Eng3D contributors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+// Name:
+//      pak.cpp
+//
+// Abstract:
+//      Reading and writing of packed asset archives.
+// ----------------------------------------------------------------------------
+
+#include <cstring>
+#include <algorithm>
+#include <numeric>
+#include <filesystem>
+#include <memory>
+#include <bit>
+#include <tbb/parallel_for.h>
+#ifdef E3D_TARGET_UNIX
+#   include <unistd.h>
+#endif
+#include "eng3d/pak.hpp"
+#include "eng3d/serializer.hpp"
+#include "eng3d/hash.hpp"
+#include "eng3d/log.hpp"
+#include "eng3d/utils.hpp"
+
+constexpr char pak_signature[4] = { 'E', '3', 'P', 'K' };
+/// @brief Bumped each time the layout of packed archives changes
+constexpr uint16_t pak_version = 2;
+
+/// @brief Fixed size header at the start of a packed archive, the fields are stored
+/// little endian (see pak_order)
+struct PakHeader {
+    char signature[4];
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t index_len;
+    uint32_t index_checksum;
+};
+static_assert(sizeof(PakHeader) == 16);
+
+/// @brief Converts the fields of the header between little endian and the host order
+template<typename T>
+static T pak_order(T value) {
+    if constexpr(sizeof(T) > 1 && std::endian::native == std::endian::big)
+        return std::byteswap(value);
+    else
+        return value;
+}
+
+/// @brief The index is stored as separate arrays of each field of the entries
+template<bool is_serialize>
+static void deser_pak_index(Archive& ar, std::vector<Eng3D::IO::PakEntry>& entries) {
+    std::vector<std::string> paths;
+    std::vector<uint64_t> offsets, sizes, inf_sizes, hashes;
+    std::vector<uint8_t> codecs;
+    std::vector<uint32_t> checksums;
+    if constexpr(is_serialize) {
+        for(const auto& entry : entries) {
+            paths.push_back(entry.path);
+            offsets.push_back(entry.offset);
+            sizes.push_back(entry.size);
+            inf_sizes.push_back(entry.inf_size);
+            codecs.push_back(static_cast<uint8_t>(entry.codec));
+            checksums.push_back(entry.checksum);
+            hashes.push_back(entry.hash);
+        }
+    }
+    ::deser_dynamic<is_serialize>(ar, paths);
+    ::deser_dynamic<is_serialize>(ar, offsets);
+    ::deser_dynamic<is_serialize>(ar, sizes);
+    ::deser_dynamic<is_serialize>(ar, inf_sizes);
+    ::deser_dynamic<is_serialize>(ar, codecs);
+    ::deser_dynamic<is_serialize>(ar, checksums);
+    ::deser_dynamic<is_serialize>(ar, hashes);
+    if constexpr(!is_serialize) {
+        const auto n = paths.size();
+        if(offsets.size() != n || sizes.size() != n || inf_sizes.size() != n || codecs.size() != n || checksums.size() != n || hashes.size() != n)
+            CXX_THROW(SerializerException, "Inconsistent packed archive index");
+        entries.resize(n);
+        for(size_t i = 0; i < n; i++) {
+            if(!Eng3D::Compression::is_valid_codec(codecs[i]))
+                CXX_THROW(SerializerException, "Unknown codec on packed archive");
+            entries[i].path = std::move(paths[i]);
+            entries[i].offset = offsets[i];
+            entries[i].size = sizes[i];
+            entries[i].inf_size = inf_sizes[i];
+            entries[i].codec = static_cast<Eng3D::Compression::Codec>(codecs[i]);
+            entries[i].checksum = checksums[i];
+            entries[i].hash = hashes[i];
+        }
+    }
+}
+
+//
+// PakFile
+//
+Eng3D::IO::PakFile::PakFile(const std::string& _path)
+    : path{ _path },
+    file(_path)
+{
+    PakHeader header;
+    if(file.size() < sizeof(header))
+        CXX_THROW(std::runtime_error, Eng3D::translate_format("Packed archive %s is truncated", path.c_str()));
+    std::memcpy(&header, file.data(), sizeof(header));
+    header.version = pak_order(header.version);
+    header.index_len = pak_order(header.index_len);
+    header.index_checksum = pak_order(header.index_checksum);
+    if(std::memcmp(header.signature, pak_signature, sizeof(pak_signature)) != 0)
+        CXX_THROW(std::runtime_error, Eng3D::translate_format("%s is not a packed archive", path.c_str()));
+    if(header.version != pak_version)
+        CXX_THROW(std::runtime_error, Eng3D::translate_format("Unsupported packed archive version %u", header.version));
+    if(header.index_len > file.size() - sizeof(header))
+        CXX_THROW(std::runtime_error, Eng3D::translate_format("Packed archive %s is truncated", path.c_str()));
+    const auto* index = file.data() + sizeof(header);
+    if(Eng3D::Hash::crc32c(index, header.index_len) != header.index_checksum)
+        CXX_THROW(std::runtime_error, Eng3D::translate_format("Checksum mismatch on packed archive %s", path.c_str()));
+
+    Archive ar{};
+    ar.buffer.assign(index, index + header.index_len);
+    deser_pak_index<false>(ar, entries);
+    for(const auto& entry : entries)
+        if(entry.offset > file.size() || entry.size > file.size() - entry.offset)
+            CXX_THROW(std::runtime_error, Eng3D::translate_format("Packed archive %s is truncated", path.c_str()));
+    // Lookups are binary searches
+    if(!std::is_sorted(entries.begin(), entries.end(), [](const auto& a, const auto& b) { return a.path < b.path; }))
+        CXX_THROW(std::runtime_error, Eng3D::translate_format("Packed archive %s has an unsorted index", path.c_str()));
+}
+
+const Eng3D::IO::PakEntry* Eng3D::IO::PakFile::find(std::string_view _path) const {
+    auto it = std::lower_bound(entries.begin(), entries.end(), _path, [](const auto& entry, std::string_view value) {
+        return std::string_view(entry.path) < value;
+    });
+    return it != entries.end() && it->path == _path ? &(*it) : nullptr;
+}
+
+/// @brief Stored bytes of an entry, which are compressed if the codec of the entry isn't NONE
+const uint8_t* Eng3D::IO::PakFile::get_data(const Eng3D::IO::PakEntry& entry) const {
+    return file.data() + entry.offset;
+}
+
+void Eng3D::IO::PakFile::verify(const Eng3D::IO::PakEntry& entry) const {
+    if(Eng3D::Hash::crc32c(get_data(entry), entry.size) != entry.checksum)
+        CXX_THROW(std::runtime_error, Eng3D::translate_format("Checksum mismatch on %s of packed archive %s", entry.path.c_str(), path.c_str()));
+}
+
+/// @brief Verifies and decompresses an entry
+std::vector<uint8_t> Eng3D::IO::PakFile::read(const Eng3D::IO::PakEntry& entry) const {
+    verify(entry);
+    std::vector<uint8_t> data(entry.inf_size);
+    if(Eng3D::Compression::decompress(entry.codec, get_data(entry), entry.size, data.data(), data.size()) != entry.inf_size)
+        CXX_THROW(std::runtime_error, Eng3D::translate_format("Corrupted %s on packed archive %s", entry.path.c_str(), path.c_str()));
+    return data;
+}
+
+//
+// Packing
+//
+/// @brief Packs all the files of a directory onto a packed archive, each file is compressed
+/// with the given settings unless it doesn't shrink (i.e already compressed images or sounds)
+/// @param dir Root of the package
+/// @param pak_path Destination path
+/// @param settings Codec and level to use
+void Eng3D::IO::pack_directory(const std::string& dir, const std::string& pak_path, Eng3D::Compression::Settings settings) {
+    std::vector<std::filesystem::path> files;
+    for(const auto& entry : std::filesystem::recursive_directory_iterator(dir))
+        if(!entry.is_directory())
+            files.push_back(entry.path());
+    std::vector<Eng3D::IO::PakEntry> entries(files.size());
+    for(size_t i = 0; i < files.size(); i++) {
+        entries[i].path = files[i].lexically_relative(dir).string();
+#ifdef E3D_TARGET_WINDOWS
+        std::replace(entries[i].path.begin(), entries[i].path.end(), '\\', '/');
+#endif
+    }
+
+    std::vector<std::vector<uint8_t>> blobs(files.size());
+    tbb::parallel_for(static_cast<size_t>(0), files.size(), [&](const auto i) {
+        auto& entry = entries[i];
+        auto& blob = blobs[i];
+        std::unique_ptr<FILE, decltype(&std::fclose)> fp(std::fopen(files[i].string().c_str(), "rb"), std::fclose);
+        if(fp == nullptr)
+            CXX_THROW(std::runtime_error, Eng3D::translate_format("Can't read %s", files[i].string().c_str()));
+        uint8_t buf[65536];
+        size_t n;
+        while((n = std::fread(buf, 1, sizeof(buf), fp.get())) > 0)
+            blob.insert(blob.end(), buf, buf + n);
+        entry.inf_size = blob.size();
+        entry.hash = Eng3D::Hash::xxh64(blob.data(), blob.size());
+        if(settings.codec != Eng3D::Compression::Codec::NONE && !blob.empty()) {
+            std::vector<uint8_t> packed(Eng3D::Compression::compress_bound(settings.codec, blob.size()));
+            packed.resize(Eng3D::Compression::compress(settings, blob.data(), blob.size(), packed.data(), packed.size()));
+            // Not worth decompressing for less than a 10% saving
+            if(packed.size() < blob.size() - blob.size() / 10) {
+                blob = std::move(packed);
+                entry.codec = settings.codec;
+            }
+        }
+        entry.size = blob.size();
+        entry.checksum = Eng3D::Hash::crc32c(blob.data(), blob.size());
+    });
+
+    std::vector<size_t> order(files.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](const auto a, const auto b) {
+        return entries[a].path < entries[b].path;
+    });
+    std::vector<Eng3D::IO::PakEntry> sorted_entries;
+    for(const auto i : order)
+        sorted_entries.push_back(entries[i]);
+
+    // The size of the index doesn't depend on the offsets, as they are fixed size integers
+    const auto align = [](uint64_t offset) {
+        return (offset + pak_alignment - 1) / pak_alignment * pak_alignment;
+    };
+    Archive index{};
+    deser_pak_index<true>(index, sorted_entries);
+    uint64_t offset = align(sizeof(PakHeader) + index.size());
+    for(size_t i = 0; i < order.size(); i++) {
+        sorted_entries[i].offset = offset;
+        offset = align(offset + sorted_entries[i].size);
+    }
+    index = Archive{};
+    deser_pak_index<true>(index, sorted_entries);
+
+    PakHeader header{};
+    std::memcpy(header.signature, pak_signature, sizeof(pak_signature));
+    header.version = pak_order(pak_version);
+    header.index_len = pak_order(static_cast<uint32_t>(index.size()));
+    header.index_checksum = pak_order(Eng3D::Hash::crc32c(index.buffer.data(), index.size()));
+
+    // Written onto a temporary file which then replaces the destination, so a crash (or
+    // a failed write) never leaves a truncated pack behind
+    const std::string tmp_path = pak_path + ".tmp";
+    std::unique_ptr<FILE, decltype(&std::fclose)> fp(std::fopen(tmp_path.c_str(), "wb"), std::fclose);
+    if(fp == nullptr)
+        CXX_THROW(std::runtime_error, Eng3D::translate_format("Can't open %s for writing", tmp_path.c_str()));
+    uint64_t written = 0;
+    try {
+        const uint8_t padding[pak_alignment] = {};
+        const auto write = [&](const void* data, size_t size) {
+            if(size == 0) return; // Empty files have no data pointer
+            if(std::fwrite(data, 1, size, fp.get()) != size)
+                CXX_THROW(std::runtime_error, Eng3D::translate_format("Can't write %s", tmp_path.c_str()));
+            written += size;
+        };
+        write(&header, sizeof(header));
+        write(index.buffer.data(), index.size());
+        for(size_t i = 0; i < order.size(); i++) {
+            write(padding, sorted_entries[i].offset - written);
+            write(blobs[order[i]].data(), blobs[order[i]].size());
+        }
+        if(std::fflush(fp.get()) != 0)
+            CXX_THROW(std::runtime_error, Eng3D::translate_format("Can't write %s", tmp_path.c_str()));
+#ifdef E3D_TARGET_UNIX
+        if(::fsync(::fileno(fp.get())) != 0)
+            CXX_THROW(std::runtime_error, Eng3D::translate_format("Can't write %s", tmp_path.c_str()));
+#endif
+        if(std::fclose(fp.release()) != 0)
+            CXX_THROW(std::runtime_error, Eng3D::translate_format("Can't write %s", tmp_path.c_str()));
+    } catch(...) {
+        // Don't leave the partially written file behind
+        fp.reset();
+        std::error_code ec;
+        std::filesystem::remove(tmp_path, ec);
+        throw;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, pak_path, ec);
+    if(ec) {
+        std::error_code remove_ec;
+        std::filesystem::remove(tmp_path, remove_ec);
+        CXX_THROW(std::runtime_error, Eng3D::translate_format("Can't replace %s: %s", pak_path.c_str(), ec.message().c_str()));
+    }
+    Eng3D::Log::debug("package", Eng3D::translate_format("Packed %zu files of %s onto %s, %llu bytes", files.size(), dir.c_str(), pak_path.c_str(), static_cast<unsigned long long>(written)));
+}
@@ -0,0 +1,66 @@
+// Eng3D - General purpouse game engine
+// Copyright (C) 2021, Eng3D contributors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+// Name:
+//      pak.hpp
+//
+// Abstract:
+//      Packed asset archives, a single file holding a sorted index and the
+//      (optionally compressed) contents of every file of a package.
+// ----------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "eng3d/io.hpp"
+#include "eng3d/codec.hpp"
+
+namespace Eng3D::IO {
+    struct PakEntry {
+        std::string path;
+        uint64_t offset = 0; // From the start of the archive
+        uint64_t size = 0; // Stored size
+        uint64_t inf_size = 0; // Size once decompressed
+        Eng3D::Compression::Codec codec = Eng3D::Compression::Codec::NONE;
+        uint32_t checksum = 0; // Of the stored bytes
+        uint64_t hash = 0; // xxh64 of the contents once decompressed, identifies duplicates
+    };
+
+    /// @brief A packed archive, mapped onto memory for as long as the object lives. The
+    /// file starts with a header, followed by the index (an archive with the entries sorted
+    /// by path) and by the contents of the files, each one aligned to pak_alignment
+    class PakFile {
+    public:
+        PakFile(const std::string& path);
+        ~PakFile() = default;
+        const Eng3D::IO::PakEntry* find(std::string_view path) const;
+        const uint8_t* get_data(const Eng3D::IO::PakEntry& entry) const;
+        void verify(const Eng3D::IO::PakEntry& entry) const;
+        std::vector<uint8_t> read(const Eng3D::IO::PakEntry& entry) const;
+
+        std::string path;
+        std::vector<Eng3D::IO::PakEntry> entries;
+        Eng3D::IO::MappedFile file;
+    };
+
+    constexpr size_t pak_alignment = 64;
+
+    void pack_directory(const std::string& dir, const std::string& pak_path, Eng3D::Compression::Settings settings);
+}
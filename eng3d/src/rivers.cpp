@@ -49,7 +49,7 @@ Eng3D::Rivers::Rivers(Eng3D::State& _s, bool lazy_init)
     {
         auto vs_shader = *s.builtin_shaders["vs_3d"].get();
         line_shader->attach_shader(vs_shader);
-        auto fs_shader = Eng3D::OpenGL::FragmentShader(s.package_man.get_unique("shaders/curve.fs")->read_all(), true);
+        auto fs_shader = Eng3D::OpenGL::FragmentShader(s.package_man.get_unique("shaders/curve.fs")->get_view().str(), true);
         line_shader->attach_shader(fs_shader);
         line_shader->link();
     }
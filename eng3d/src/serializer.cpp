@@ -26,62 +26,460 @@
 #include <fstream>
 #include <iterator>
 #include <memory>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <condition_variable>
+#include <tbb/parallel_for.h>
+#ifdef E3D_TARGET_UNIX
+#   include <unistd.h>
+#endif
+#if defined __SSE2__
+#   include <immintrin.h>
+#elif defined __ARM_NEON
+#   include <arm_neon.h>
+#endif
 #include "eng3d/serializer.hpp"
 #include "eng3d/utils.hpp"
 #include "eng3d/log.hpp"
-#include "eng3d/compress.hpp"
+#include "eng3d/hash.hpp"
 
 constexpr char archive_signature[4] = { '>', ':', ')', ' ' };
+/// @brief Bumped each time the layout of the archive file changes
+constexpr uint16_t archive_version = 5;
+/// @brief Name of the section used by plain archives
+constexpr std::string_view main_section_name = "main";
+
+namespace ArchiveFlags {
+    enum : uint8_t {
+        VARINT = 0x01,
+        QUANTIZED_FLOAT = 0x02,
+        BIG_ENDIAN_ORDER = 0x04,
+        STRING_TABLE = 0x08,
+    };
+};
 
 #define MAX_CHUNK_SIZE (65536 * 128)
 #define MAX_ARCHIVE_SIZE (65536 * 10000)
-#define MIN_FILE_SIZE 4096
+#define MAX_SECTIONS 4096
 
-void Archive::to_file(const std::string& path) {
+using unique_file = std::unique_ptr<FILE, decltype(&std::fclose)>;
+
+static void read_exact(FILE* fp, void* buf, size_t size) {
+    if(std::fread(buf, 1, size, fp) != size)
+        CXX_THROW(SerializerException, translate("Archive is truncated"));
+}
+
+/// @brief Size of the table of contents of a sectioned archive (including its trailing
+/// checksum), as stored on disk
+static size_t get_table_size(const std::deque<ArchiveSection>& sections) {
+    size_t size = sizeof(archive_signature) + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t);
+    for(const auto& section : sections)
+        size += sizeof(uint8_t) + section.name.size() + sizeof(section.offset) + sizeof(section.inf_len)
+            + sizeof(section.def_len) + sizeof(section.checksum) + sizeof(uint8_t) * 3 + sizeof(float);
+    return size;
+}
+
+/// @brief Fields of the table of contents are stored little-endian regardless of the host
+template<typename T>
+static T table_order(T value) {
+    if constexpr(std::is_floating_point_v<T>)
+        return std::bit_cast<T>(table_order(std::bit_cast<uint32_t>(value)));
+    else if constexpr(sizeof(T) > 1 && std::endian::native == std::endian::big)
+        return std::byteswap(value);
+    else
+        return value;
+}
+
+/// @brief Compresses and writes the sections onto the given path, the data is first written
+/// into a temporary file which then replaces the destination, so a crash mid-save never
+/// leaves a corrupted archive behind
+/// @param path Destination path
+/// @param sections Sections to write, the offsets, sizes and checksums are updated
+/// @param task Task to report progress to, may be null
+static void write_archive_file(const std::string& path, std::deque<ArchiveSection>& sections, ArchiveSaveTask* task) {
     Eng3D::Log::debug("archive", translate_format("Writing archive %s", path.c_str()));
-    if(buffer.empty())
-        CXX_THROW(SerializerException, translate("Can't output an empty archive to file"));
-    
-    std::unique_ptr<FILE, decltype(&std::fclose)> fp(::fopen(path.c_str(), "wb"), ::fclose);
+    if(sections.empty() || sections.size() > MAX_SECTIONS)
+        CXX_THROW(SerializerException, translate("Invalid number of archive sections"));
+    for(const auto& section : sections) {
+        if(section.archive.buffer.empty())
+            CXX_THROW(SerializerException, translate_format("Can't output an empty archive section %s to file", section.name.c_str()));
+        if(section.name.size() > std::numeric_limits<uint8_t>::max())
+            CXX_THROW(SerializerException, translate_format("Archive section name %s is too long", section.name.c_str()));
+    }
 
-    char signbuf[sizeof(archive_signature)];
-    std::memcpy(signbuf, archive_signature, sizeof(archive_signature));
-    std::fwrite(signbuf, 1, sizeof(signbuf), fp.get());
-    uint32_t inf_len = buffer.size();
-    std::fwrite(&inf_len, 1, sizeof(inf_len), fp.get());
-    std::vector<uint8_t> dest_buffer(std::max<size_t>(buffer.size(), MIN_FILE_SIZE));
-    auto r = Eng3D::Zlib::compress(buffer.data(), buffer.size(), dest_buffer.data(), dest_buffer.size());
-    dest_buffer.resize(r);
-    uint32_t def_len = dest_buffer.size();
-    std::fwrite(&def_len, 1, sizeof(def_len), fp.get());
-    std::fwrite(dest_buffer.data(), 1, dest_buffer.size(), fp.get());
-    Eng3D::Log::debug("archive", string_format("%zu->%zu bytes compressed; return value is %zu", inf_len, def_len, r));
+    if(task != nullptr) task->status = ArchiveSaveTask::Status::COMPRESSING;
+    // Sections are compressed independently of each other
+    std::vector<std::vector<uint8_t>> payloads(sections.size());
+    std::atomic<size_t> n_compressed = 0;
+    tbb::parallel_for(static_cast<size_t>(0), sections.size(), [&](const auto i) {
+        auto& section = sections[i];
+        auto& ar = section.archive;
+        // The string table is appended only for the duration of the compression
+        const size_t data_len = ar.buffer.size(), data_ptr = ar.ptr;
+        section.has_string_table = !ar.string_table.empty();
+        if(section.has_string_table)
+            ar.write_string_table();
+        section.inf_len = ar.buffer.size();
+        section.codec = ar.compression.codec;
+        auto& dest_buffer = payloads[i];
+        dest_buffer.resize(Eng3D::Compression::compress_bound(section.codec, ar.buffer.size()));
+        auto r = Eng3D::Compression::compress(ar.compression, ar.buffer.data(), ar.buffer.size(), dest_buffer.data(), dest_buffer.size());
+        ar.buffer.resize(data_len);
+        ar.ptr = data_ptr;
+        dest_buffer.resize(r);
+        if(task != nullptr)
+            task->progress = 0.8f * static_cast<float>(++n_compressed) / sections.size();
+    });
+    uint64_t offset = get_table_size(sections);
+    for(size_t i = 0; i < sections.size(); i++) {
+        auto& section = sections[i];
+        section.offset = offset;
+        section.def_len = payloads[i].size();
+        section.checksum = Eng3D::Hash::crc32c(payloads[i].data(), payloads[i].size());
+        offset += section.def_len;
+    }
+    if(task != nullptr) task->status = ArchiveSaveTask::Status::WRITING;
+
+    const std::string tmp_path = path + ".tmp";
+    unique_file fp(::fopen(tmp_path.c_str(), "wb"), ::fclose);
+    if(fp == nullptr)
+        CXX_THROW(SerializerException, translate_format("Can't open %s for writing", tmp_path.c_str()));
+    try {
+        const auto write = [&](const void* buf, size_t size) {
+            if(std::fwrite(buf, 1, size, fp.get()) != size)
+                CXX_THROW(SerializerException, translate_format("Can't write archive %s", tmp_path.c_str()));
+        };
+        // Table of contents, followed by its checksum
+        uint32_t table_checksum = 0;
+        const auto write_table = [&](const void* buf, size_t size) {
+            write(buf, size);
+            table_checksum = Eng3D::Hash::crc32c(buf, size, table_checksum);
+        };
+        const auto write_table_value = [&](auto value) {
+            value = table_order(value);
+            write_table(&value, sizeof(value));
+        };
+        write_table(archive_signature, sizeof(archive_signature));
+        write_table_value(archive_version);
+        write_table_value(static_cast<uint16_t>(sections.size()));
+        for(const auto& section : sections) {
+            const uint8_t name_len = section.name.size();
+            write_table_value(name_len);
+            write_table(section.name.data(), name_len);
+            write_table_value(section.offset);
+            write_table_value(section.inf_len);
+            write_table_value(section.def_len);
+            write_table_value(section.checksum);
+            const auto& ar = section.archive;
+            uint8_t flags[3] = { 0, ar.float_bits, static_cast<uint8_t>(section.codec) };
+            if(ar.int_mode == Archive::IntMode::VARINT) flags[0] |= ArchiveFlags::VARINT;
+            if(ar.float_mode == Archive::FloatMode::QUANTIZED) flags[0] |= ArchiveFlags::QUANTIZED_FLOAT;
+            if(ar.byte_order == std::endian::big) flags[0] |= ArchiveFlags::BIG_ENDIAN_ORDER;
+            if(section.has_string_table) flags[0] |= ArchiveFlags::STRING_TABLE;
+            write_table(flags, sizeof(flags));
+            write_table_value(ar.float_scale);
+        }
+        table_checksum = table_order(table_checksum);
+        write(&table_checksum, sizeof(table_checksum));
+        // Payloads
+        for(const auto& payload : payloads)
+            write(payload.data(), payload.size());
+        if(std::fflush(fp.get()) != 0)
+            CXX_THROW(SerializerException, translate_format("Can't write archive %s", tmp_path.c_str()));
+#ifdef E3D_TARGET_UNIX
+        if(::fsync(::fileno(fp.get())) != 0)
+            CXX_THROW(SerializerException, translate_format("Can't write archive %s", tmp_path.c_str()));
+#endif
+        if(std::fclose(fp.release()) != 0)
+            CXX_THROW(SerializerException, translate_format("Can't write archive %s", tmp_path.c_str()));
+    } catch(...) {
+        // Don't leave the partially written file behind
+        fp.reset();
+        std::error_code ec;
+        std::filesystem::remove(tmp_path, ec);
+        throw;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, path, ec);
+    if(ec) {
+        std::error_code remove_ec;
+        std::filesystem::remove(tmp_path, remove_ec);
+        CXX_THROW(SerializerException, translate_format("Can't replace archive %s: %s", path.c_str(), ec.message().c_str()));
+    }
+    for(const auto& section : sections)
+        Eng3D::Log::debug("archive", string_format("%s: %u->%u bytes compressed (%s)", section.name.c_str(), section.inf_len, section.def_len, Eng3D::Compression::get_name(section.codec)));
+}
+
+/// @brief Reads, verifies and decompresses the payload of a section
+static void read_section(const std::string& path, ArchiveSection& section) {
+    unique_file fp(::fopen(path.c_str(), "rb"), ::fclose);
+    if(fp == nullptr) CXX_THROW(std::runtime_error, translate("Can't read archive"));
+    if(std::fseek(fp.get(), static_cast<long>(section.offset), SEEK_SET) != 0)
+        CXX_THROW(SerializerException, translate("Archive is truncated"));
+    std::vector<uint8_t> src_buffer(section.def_len);
+    read_exact(fp.get(), src_buffer.data(), src_buffer.size());
+    if(Eng3D::Hash::crc32c(src_buffer.data(), src_buffer.size()) != section.checksum)
+        CXX_THROW(SerializerException, translate_format("Checksum mismatch on archive section %s", section.name.c_str()));
+
+    auto& buffer = section.archive.buffer;
+    buffer.resize(section.inf_len);
+    auto r = Eng3D::Compression::decompress(section.codec, src_buffer.data(), src_buffer.size(), buffer.data(), buffer.size());
+    if(r != section.inf_len)
+        CXX_THROW(SerializerException, translate_format("Archive section %s inflated to %zu bytes, expected %u", section.name.c_str(), r, section.inf_len));
+    Eng3D::Log::debug("archive", string_format("%s: %u<-%u bytes decompressed", section.name.c_str(), section.inf_len, section.def_len));
+    if(section.has_string_table)
+        section.archive.read_string_table();
+    section.archive.rewind();
+    section.loaded = true;
 }
 
+//
+// Archive
+//
+void Archive::to_file(const std::string& path) {
+    std::deque<ArchiveSection> sections(1);
+    sections[0].name = main_section_name;
+    // Borrow the buffer instead of copying it
+    sections[0].archive = std::move(*this);
+    try {
+        write_archive_file(path, sections, nullptr);
+    } catch(...) {
+        *this = std::move(sections[0].archive);
+        throw;
+    }
+    *this = std::move(sections[0].archive);
+}
+
+/// @brief Saves the archive on a background thread, the buffer of the archive is moved
+/// onto the task, so it's left empty (and usable for the next snapshot) after this call
+/// @param path Destination path
+/// @param callback Function called from the saving thread once the save is done
+/// @return std::shared_ptr<ArchiveSaveTask> The task that can be polled for progress
+std::shared_ptr<ArchiveSaveTask> Archive::to_file_async(const std::string& path, std::function<void(const ArchiveSaveTask&)> callback) {
+    SectionedArchive sar{};
+    auto& ar = sar.add_section(std::string(main_section_name));
+    ar = std::move(*this);
+    buffer.clear();
+    ptr = 0;
+    return sar.to_file_async(path, callback);
+}
+
+/// @brief Reads the main section of an archive file
 void Archive::from_file(const std::string& path) {
-    Eng3D::Log::debug("archive", translate_format("Reading archive %s", path.c_str()));
+    SectionedArchive sar{};
+    sar.open(path);
+    if(sar.sections.empty())
+        CXX_THROW(SerializerException, translate("Archive has no sections"));
+    auto* section = sar.find_section(main_section_name);
+    if(section == nullptr) section = &sar.sections.front();
+    *this = std::move(sar.load_section(section->name));
+}
+
+//
+// SectionedArchive
+//
+/// @brief Adds a new section to be written
+/// @param name Name of the section, should be unique
+/// @return Archive& The archive of the section, where the data is serialized onto
+Archive& SectionedArchive::add_section(const std::string& name) {
+    if(find_section(name) != nullptr)
+        CXX_THROW(SerializerException, translate_format("Duplicate archive section %s", name.c_str()));
+    auto& section = sections.emplace_back();
+    section.name = name;
+    section.loaded = true;
+    return section.archive;
+}
+
+void SectionedArchive::to_file(const std::string& path) {
+    write_archive_file(path, sections, nullptr);
+}
+
+/// @brief Reads only the table of contents of the file, the sections are loaded
+/// afterwards with load_section or load_all
+/// @param path Path of the file
+void SectionedArchive::open(const std::string& _path) {
+    Eng3D::Log::debug("archive", translate_format("Reading archive %s", _path.c_str()));
+    this->path = _path;
+    this->sections.clear();
 
-    std::unique_ptr<FILE, decltype(&std::fclose)> fp(::fopen(path.c_str(), "rb"), ::fclose);
+    unique_file fp(::fopen(path.c_str(), "rb"), ::fclose);
     if(fp == nullptr) CXX_THROW(std::runtime_error, translate("Can't read archive"));
-    
-    std::vector<uint8_t> src_buffer(buffer.size());
-    
+    uint32_t table_checksum = 0;
+    const auto read_table = [&](void* buf, size_t size) {
+        read_exact(fp.get(), buf, size);
+        table_checksum = Eng3D::Hash::crc32c(buf, size, table_checksum);
+    };
+    const auto read_table_value = [&](auto& value) {
+        read_table(&value, sizeof(value));
+        value = table_order(value);
+    };
     char signbuf[sizeof(archive_signature)];
-    std::fread(signbuf, 1, sizeof(signbuf), fp.get());
+    read_table(signbuf, sizeof(signbuf));
     if(memcmp(archive_signature, signbuf, sizeof(signbuf)) != 0)
         CXX_THROW(std::runtime_error, "Invalid archive");
-    uint32_t inf_len;
-    std::fread(&inf_len, 1, sizeof(inf_len), fp.get());
-    uint32_t def_len;
-    std::fread(&def_len, 1, sizeof(def_len), fp.get());
-    if(def_len >= MAX_ARCHIVE_SIZE) CXX_THROW(std::runtime_error, "Exceeded archive size");
-    src_buffer.resize(def_len);
-    std::fread(src_buffer.data(), 1, src_buffer.size(), fp.get());
+    uint16_t version = 0;
+    read_table_value(version);
+    if(version != archive_version)
+        CXX_THROW(std::runtime_error, string_format("Unsupported archive version %u", version));
+    uint16_t n_sections = 0;
+    read_table_value(n_sections);
+    if(n_sections > MAX_SECTIONS)
+        CXX_THROW(SerializerException, translate("Invalid number of archive sections"));
+    for(size_t i = 0; i < n_sections; i++) {
+        auto& section = sections.emplace_back();
+        uint8_t name_len = 0;
+        read_table_value(name_len);
+        section.name.resize(name_len);
+        read_table(section.name.data(), name_len);
+        read_table_value(section.offset);
+        read_table_value(section.inf_len);
+        read_table_value(section.def_len);
+        read_table_value(section.checksum);
+        if(section.def_len >= MAX_ARCHIVE_SIZE || section.inf_len >= MAX_ARCHIVE_SIZE)
+            CXX_THROW(std::runtime_error, "Exceeded archive size");
+        auto& ar = section.archive;
+        uint8_t flags[3] = {};
+        read_table(flags, sizeof(flags));
+        ar.int_mode = (flags[0] & ArchiveFlags::VARINT) ? Archive::IntMode::VARINT : Archive::IntMode::FIXED;
+        ar.float_mode = (flags[0] & ArchiveFlags::QUANTIZED_FLOAT) ? Archive::FloatMode::QUANTIZED : Archive::FloatMode::RAW;
+        ar.byte_order = (flags[0] & ArchiveFlags::BIG_ENDIAN_ORDER) ? std::endian::big : std::endian::little;
+        section.has_string_table = flags[0] & ArchiveFlags::STRING_TABLE;
+        ar.float_bits = flags[1];
+        if(!Eng3D::Compression::is_valid_codec(flags[2]))
+            CXX_THROW(SerializerException, translate_format("Unknown codec on archive section %s", section.name.c_str()));
+        section.codec = static_cast<Eng3D::Compression::Codec>(flags[2]);
+        ar.compression.codec = section.codec;
+        read_table_value(ar.float_scale);
+    }
+    uint32_t checksum = 0;
+    read_exact(fp.get(), &checksum, sizeof(checksum));
+    checksum = table_order(checksum);
+    if(checksum != table_checksum)
+        CXX_THROW(SerializerException, translate("Checksum mismatch on archive table"));
+}
+
+/// @brief Loads a section (if not loaded already)
+/// @param name Name of the section
+/// @return Archive& The archive of the section, rewinded
+Archive& SectionedArchive::load_section(const std::string& name) {
+    auto* section = find_section(name);
+    if(section == nullptr)
+        CXX_THROW(SerializerException, translate_format("Archive section %s not found", name.c_str()));
+    if(!section->loaded)
+        read_section(path, *section);
+    return section->archive;
+}
 
-    buffer.resize(inf_len);
-    auto r = Eng3D::Zlib::decompress(src_buffer.data(), src_buffer.size(), buffer.data(), buffer.size());
-    Eng3D::Log::debug("archive", string_format("%zu<-%zu bytes decompressed; return value is %zu", inf_len, def_len, r));
-    buffer.shrink_to_fit();
+/// @brief Loads all the sections that aren't loaded yet, in parallel
+void SectionedArchive::load_all() {
+    tbb::parallel_for(static_cast<size_t>(0), sections.size(), [this](const auto i) {
+        if(!sections[i].loaded)
+            read_section(path, sections[i]);
+    });
+}
+
+/// @brief Single background thread that writes the archives, saves are done in the
+/// order they were requested - so an older autosave never overwrites a newer one
+class ArchiveSaver {
+    std::thread thread;
+    std::deque<std::shared_ptr<ArchiveSaveTask>> tasks;
+    std::mutex tasks_mutex;
+    std::condition_variable cv_task;
+    bool running = true;
+
+    void thread_loop() {
+        while(true) {
+            std::unique_lock<std::mutex> latch(tasks_mutex);
+            cv_task.wait(latch, [this]() {
+                return !running || !tasks.empty();
+            });
+            // Pending saves are still flushed when shutting down
+            if(tasks.empty()) break;
+            auto task = tasks.front();
+            tasks.pop_front();
+            latch.unlock();
+
+            try {
+                write_archive_file(task->path, task->archive.sections, task.get());
+                task->progress = 1.f;
+                task->status = ArchiveSaveTask::Status::DONE;
+            } catch(const std::exception& e) {
+                task->error = e.what();
+                task->status = ArchiveSaveTask::Status::FAILED;
+                Eng3D::Log::error("archive", translate_format("Failed to save %s: %s", task->path.c_str(), e.what()));
+            }
+            task->archive = SectionedArchive{};
+            if(task->callback) task->callback(*task);
+            task->status.notify_all();
+        }
+    }
+public:
+    ArchiveSaver()
+        : thread(&ArchiveSaver::thread_loop, this)
+    {
+
+    }
+
+    ~ArchiveSaver() {
+        std::unique_lock<std::mutex> latch(tasks_mutex);
+        running = false;
+        cv_task.notify_all();
+        latch.unlock();
+        thread.join();
+    }
+
+    void add_task(std::shared_ptr<ArchiveSaveTask> task) {
+        const std::scoped_lock lock(tasks_mutex);
+        tasks.push_back(task);
+        cv_task.notify_one();
+    }
+
+    static ArchiveSaver& get_instance() {
+        static ArchiveSaver saver;
+        return saver;
+    }
+};
+
+/// @brief Blocks until the task has been completed (or has failed)
+void ArchiveSaveTask::wait() {
+    for(auto st = status.load(); st != Status::DONE && st != Status::FAILED; st = status.load())
+        status.wait(st);
+}
+
+/// @brief Saves the sections on a background thread, the sections are moved onto the
+/// task, so this object is left empty after this call
+/// @param path Destination path
+/// @param callback Function called from the saving thread once the save is done
+/// @return std::shared_ptr<ArchiveSaveTask> The task that can be polled for progress
+std::shared_ptr<ArchiveSaveTask> SectionedArchive::to_file_async(const std::string& _path, std::function<void(const ArchiveSaveTask&)> callback) {
+    for(const auto& section : sections)
+        if(section.archive.buffer.empty())
+            CXX_THROW(SerializerException, translate_format("Can't output an empty archive section %s to file", section.name.c_str()));
+    auto task = std::make_shared<ArchiveSaveTask>();
+    task->path = _path;
+    task->archive.sections = std::move(sections);
+    task->callback = callback;
+    sections.clear();
+    ArchiveSaver::get_instance().add_task(task);
+    return task;
+}
+
+/// @brief Resolves all the entity pointers that were deserialized, in a single pass
+/// and without any lookups, since entities are indexed by their id
+void Archive::resolve_entities() {
+    for(auto& table : entity_tables) {
+        if(!table.fixups.empty() && table.base == nullptr)
+            CXX_THROW(SerializerException, "Entity list was not registered before resolving");
+        for(const auto& fixup : table.fixups) {
+            if(fixup.id != invalid_entity_id && fixup.id >= table.count)
+                CXX_THROW(SerializerException, string_format("Entity id %zu out of bounds (%zu entities)", fixup.id, table.count));
+            table.assign(fixup.slot, table.base, fixup.id);
+        }
+        table.fixups.clear();
+    }
 }
 
 void Archive::copy_to(void* ptr, size_t size) {
@@ -91,6 +489,155 @@ void Archive::copy_to(void* ptr, size_t size) {
     this->ptr += size;
 }
 
+template<typename T>
+static void byteswap_copy_scalar(uint8_t* dst, const uint8_t* src, size_t count) {
+    for(size_t i = 0; i < count; i++) {
+        T value;
+        std::memcpy(&value, src + i * sizeof(T), sizeof(T));
+        value = std::byteswap(value);
+        std::memcpy(dst + i * sizeof(T), &value, sizeof(T));
+    }
+}
+
+/// @brief Copies count elements of elem_size bytes each reversing the byte order of
+/// every element, dst and src may be the same buffer
+static void byteswap_copy(void* dst_ptr, const void* src_ptr, size_t count, size_t elem_size) {
+    auto* dst = static_cast<uint8_t*>(dst_ptr);
+    const auto* src = static_cast<const uint8_t*>(src_ptr);
+    const size_t size = count * elem_size;
+    size_t i = 0;
+#if defined __SSSE3__
+    alignas(32) uint8_t lanes[32];
+    for(size_t j = 0; j < sizeof(lanes); j++)
+        lanes[j] = static_cast<uint8_t>((j % 16) / elem_size * elem_size + (elem_size - 1 - j % elem_size));
+#   if defined __AVX2__
+    const __m256i mask256 = _mm256_load_si256(reinterpret_cast<const __m256i*>(lanes));
+    for(; i + 32 <= size; i += 32) {
+        const auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_shuffle_epi8(v, mask256));
+    }
+#   endif
+    const __m128i mask = _mm_load_si128(reinterpret_cast<const __m128i*>(lanes));
+    for(; i + 16 <= size; i += 16) {
+        const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_shuffle_epi8(v, mask));
+    }
+#elif defined __SSE2__
+    // Without a byte shuffle: reorder the 16-bit words and then swap the bytes of each
+    for(; i + 16 <= size; i += 16) {
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        if(elem_size == 4) {
+            v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+            v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        } else if(elem_size == 8) {
+            v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+            v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+        }
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+    }
+#elif defined __ARM_NEON
+    for(; i + 16 <= size; i += 16) {
+        auto v = vld1q_u8(src + i);
+        if(elem_size == 2) v = vrev16q_u8(v);
+        else if(elem_size == 4) v = vrev32q_u8(v);
+        else v = vrev64q_u8(v);
+        vst1q_u8(dst + i, v);
+    }
+#endif
+    // Remaining elements, the vector loops only stop at element boundaries
+    switch(elem_size) {
+    case 2: byteswap_copy_scalar<uint16_t>(dst + i, src + i, (size - i) / 2); break;
+    case 4: byteswap_copy_scalar<uint32_t>(dst + i, src + i, (size - i) / 4); break;
+    case 8: byteswap_copy_scalar<uint64_t>(dst + i, src + i, (size - i) / 8); break;
+    default: CXX_THROW(SerializerException, string_format("Can't swap elements of %zu bytes", elem_size));
+    }
+}
+
+/// @brief Appends the string table at the end of the stream: the number of strings, each
+/// string prefixed by its length, and lastly the size of the whole table
+void Archive::write_string_table() {
+    ptr = buffer.size();
+    const size_t start = ptr;
+    write_varint(string_table.size());
+    for(const auto ref : string_table) {
+        const auto str = ref.get_string();
+        write_varint(str.size());
+        copy_from(str.data(), str.size());
+    }
+    uint32_t table_size = buffer.size() - start;
+    if constexpr(std::endian::native == std::endian::big)
+        table_size = std::byteswap(table_size);
+    copy_from(&table_size, sizeof(table_size));
+}
+
+/// @brief Reads the string table from the end of the stream, interns all the strings
+/// at once and strips the table off the buffer
+void Archive::read_string_table() {
+    uint32_t table_size = 0;
+    if(buffer.size() < sizeof(table_size))
+        CXX_THROW(SerializerException, "Archive has no string table");
+    std::memcpy(&table_size, &buffer[buffer.size() - sizeof(table_size)], sizeof(table_size));
+    if constexpr(std::endian::native == std::endian::big)
+        table_size = std::byteswap(table_size);
+    if(table_size > buffer.size() - sizeof(table_size))
+        CXX_THROW(SerializerException, "String table is truncated");
+    const size_t start = buffer.size() - sizeof(table_size) - table_size;
+    const size_t end = buffer.size() - sizeof(table_size);
+
+    ptr = start;
+    const auto n_strings = read_varint();
+    if(n_strings > table_size)
+        CXX_THROW(SerializerException, "String table is truncated");
+    std::vector<std::string_view> strs;
+    strs.reserve(n_strings);
+    for(size_t i = 0; i < n_strings; i++) {
+        const auto len = ptr <= end ? read_varint() : 0;
+        if(ptr > end || len > end - ptr)
+            CXX_THROW(SerializerException, "String table is truncated");
+        strs.emplace_back(reinterpret_cast<const char*>(&buffer[ptr]), len);
+        ptr += len;
+    }
+    string_table = Eng3D::StringManager::get_instance().insert(strs);
+    string_indices.clear();
+    buffer.resize(start);
+    ptr = 0;
+}
+
+/// @brief Checksum of the contents of the archive, cheap enough to compare states
+/// between peers every tick to detect desyncs
+/// @return uint32_t CRC32C of the buffer
+uint32_t Archive::checksum() const {
+    return Eng3D::Hash::crc32c(buffer.data(), buffer.size());
+}
+
+/// @brief Reads count elements of elem_size bytes, swapping their byte order
+void Archive::copy_to_swapped(void* ptr, size_t count, size_t elem_size) {
+    copy_to(ptr, count * elem_size);
+    byteswap_copy(ptr, ptr, count, elem_size);
+}
+
+/// @brief Writes count elements of elem_size bytes, swapping their byte order
+void Archive::copy_from_swapped(const void* ptr, size_t count, size_t elem_size) {
+    const size_t size = count * elem_size;
+    this->expand(size);
+    byteswap_copy(&buffer[this->ptr], ptr, count, elem_size);
+    this->ptr += size;
+}
+
+/// @brief Byte-by-byte decoding of a varint, used near the end of the stream
+/// @return uint64_t The decoded value
+uint64_t Archive::read_varint_slow() {
+    uint64_t value = 0;
+    for(size_t i = 0; i < max_varint_size; i++) {
+        uint8_t byte;
+        copy_to(&byte, sizeof(byte));
+        value |= static_cast<uint64_t>(byte & 0x7F) << (i * 7);
+        if(!(byte & 0x80)) return value;
+    }
+    CXX_THROW(SerializerException, "Varint is too long");
+}
+
 void Archive::copy_from(const void* ptr, size_t size) {
     this->expand(size);
     if(size > buffer.size() - this->ptr)
@@ -31,12 +31,28 @@
 #include <numeric>
 #include <string>
 #include <vector>
+#include <deque>
+#include <array>
+#include <bitset>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
 #include <memory>
 #include <cstdio>
 #include <type_traits>
 #include <limits>
+#include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <functional>
+#include <bit>
+#ifdef __BMI2__
+#   include <immintrin.h>
+#endif
 #include <glm/glm.hpp>
 #include "eng3d/utils.hpp"
+#include "eng3d/string.hpp"
+#include "eng3d/codec.hpp"
 
 /// @brief The purpouse of the serializer is to serialize objects onto a byte stream
 /// that can be transfered onto the disk or over the network. Should the object have
@@ -53,15 +69,33 @@ public:
     };
 };
 
+struct ArchiveSaveTask;
+
+inline size_t entity_type_counter() {
+    static std::atomic<size_t> n_types = 0;
+    return n_types++;
+}
+
+/// @brief Obtains an unique, sequential index for the type T, so per-type data can be
+/// looked up on a plain array
+template<typename T>
+inline size_t entity_type_slot() {
+    static const size_t slot = entity_type_counter();
+    return slot;
+}
 /// @brief Base class that serves as archiver, stores (in memory) the data required for
 /// serialization/deserialization
 struct Archive {
     Archive() = default;
     ~Archive() = default;
     void to_file(const std::string& path);
+    std::shared_ptr<ArchiveSaveTask> to_file_async(const std::string& path, std::function<void(const ArchiveSaveTask&)> callback = nullptr);
     void from_file(const std::string& path);
     void copy_to(void* ptr, size_t size);
     void copy_from(const void* ptr, size_t size);
+    void copy_to_swapped(void* ptr, size_t count, size_t elem_size);
+    uint32_t checksum() const;
+    void copy_from_swapped(const void* ptr, size_t count, size_t elem_size);
 
     inline void expand(size_t amount) {
         buffer.resize(buffer.size() + amount);
@@ -75,6 +109,10 @@ struct Archive {
         ptr = 0;
     }
 
+    /// @brief Raw contents of the archive, to send it to another process. String references
+    /// are indexes onto string_table, which isn't part of the buffer unless write_string_table
+    /// was called (and the receiver calls read_string_table after set_buffer), files do it
+    /// on their own
     inline const void* get_buffer() {
         return static_cast<const void*>(&buffer[0]);
     }
@@ -88,10 +126,272 @@ struct Archive {
         return buffer.size();
     }
 
+    /// @brief Encodes an unsigned LEB128 variable length integer, p must have room for
+    /// max_varint_size bytes
+    /// @return size_t Number of bytes written
+    static inline size_t encode_varint(uint8_t* p, uint64_t value) {
+        size_t n = 0;
+        for(; value >= 0x80; value >>= 7)
+            p[n++] = static_cast<uint8_t>(value | 0x80);
+        p[n++] = static_cast<uint8_t>(value);
+        return n;
+    }
+
+    /// @brief Zigzag encoding of signed integers, so small negative numbers stay small
+    template<typename T>
+    static inline uint64_t zigzag(T value) {
+        if constexpr(std::is_signed_v<T>)
+            return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(value) >> 63);
+        else
+            return static_cast<uint64_t>(value);
+    }
+
+    /// @brief Writes an unsigned LEB128 variable length integer, the encoded size is known
+    /// upfront so the buffer grows once and the bytes are written straight onto it
+    inline void write_varint(uint64_t value) {
+        const size_t n = (std::bit_width(value | 1) + 6) / 7;
+        expand(n);
+        encode_varint(&buffer[ptr], value);
+        ptr += n;
+    }
+
+    /// @brief Writes a run of integers as varints, the worst case is reserved once for the
+    /// whole run and the unused tail is trimmed afterwards
+    template<typename T>
+    inline void write_varints(const T* values, size_t count) {
+        const size_t reserved = count * max_varint_size;
+        expand(reserved);
+        auto* p = &buffer[ptr];
+        size_t n = 0;
+        for(size_t i = 0; i < count; i++)
+            n += encode_varint(p + n, zigzag(values[i]));
+        ptr += n;
+        buffer.resize(buffer.size() - (reserved - n));
+    }
+
+    /// @brief Reads an unsigned LEB128 variable length integer, when there are at least
+    /// 8 bytes left on the stream the value is decoded without any branching with a
+    /// single word load
+    inline uint64_t read_varint() {
+        if(buffer.size() - ptr >= sizeof(uint64_t)) {
+            uint64_t word;
+            std::memcpy(&word, &buffer[ptr], sizeof(word));
+            if constexpr(std::endian::native == std::endian::big)
+                word = std::byteswap(word);
+            // The terminating byte is the first one with the high bit cleared
+            const uint64_t stops = ~word & 0x8080808080808080ULL;
+            if(stops) {
+                ptr += (std::countr_zero(stops) >> 3) + 1;
+                word &= stops ^ (stops - 1); // Discard bytes after the terminator
+#ifdef __BMI2__
+                return _pext_u64(word, 0x7F7F7F7F7F7F7F7FULL);
+#else
+                // Pack the 7-bit groups together, doubling the group width each step
+                word &= 0x7F7F7F7F7F7F7F7FULL;
+                word = (word & 0x007F007F007F007FULL) | ((word & 0x7F007F007F007F00ULL) >> 1);
+                word = (word & 0x00003FFF00003FFFULL) | ((word & 0x3FFF00003FFF0000ULL) >> 2);
+                word = (word & 0x000000000FFFFFFFULL) | ((word & 0x0FFFFFFF00000000ULL) >> 4);
+                return word;
+#endif
+            }
+        }
+        return read_varint_slow();
+    }
+
+    uint64_t read_varint_slow();
+
+    /// @brief How integers (wider than a byte) are encoded on the stream
+    enum class IntMode : uint8_t {
+        FIXED, // As-is, sizeof(T) bytes
+        VARINT, // LEB128, signed integers are zigzag encoded first
+    };
+    IntMode int_mode = IntMode::FIXED;
+    constexpr static size_t max_varint_size = 10;
+
+    /// @brief How floating point values are encoded on the stream
+    enum class FloatMode : uint8_t {
+        RAW, // Bit-exact IEEE 754 representation
+        QUANTIZED, // Fixed point, multiplied by float_scale and clamped into float_bits bits
+    };
+    FloatMode float_mode = FloatMode::RAW;
+    float float_scale = 1000.f;
+    uint8_t float_bits = 32;
+
+    /// @brief Byte order of fixed size integers and floats on the stream, values are
+    /// swapped when it differs from the one of the host
+    std::endian byte_order = std::endian::little;
+    inline bool is_swapped() const {
+        return byte_order != std::endian::native;
+    }
+
+    /// @brief Codec (and level) used when the archive is written onto a file, every
+    /// section records the codec it was written with so reading doesn't depend on it
+    Eng3D::Compression::Settings compression;
+
+    /// @brief A pointer to an entity which is pending to be resolved
+    struct EntityFixup {
+        void* slot; // Address of the pointer
+        size_t id;
+    };
+
+    /// @brief Registered list of entities of a given type, entities are expected to be
+    /// stored contiguously and indexed by their id
+    struct EntityTable {
+        void* base = nullptr;
+        size_t count = 0;
+        void (*assign)(void* slot, void* base, size_t id) = nullptr;
+        std::vector<EntityFixup> fixups;
+    };
+
+    /// @brief Obtains the table of entities of type T
+    template<typename T>
+    inline EntityTable& get_entity_table() {
+        const auto slot = ::entity_type_slot<T>();
+        if(slot >= entity_tables.size())
+            entity_tables.resize(slot + 1);
+        auto& table = entity_tables[slot];
+        table.assign = [](void* slot, void* base, size_t id) {
+            *static_cast<T**>(slot) = id == invalid_entity_id ? nullptr : static_cast<T*>(base) + id;
+        };
+        return table;
+    }
+
+    /// @brief Registers the list of entities that pointers of type T* point to, the
+    /// list must not be reallocated before resolve_entities is called
+    template<typename T>
+    inline void register_entities(std::vector<T>& list) {
+        auto& table = get_entity_table<T>();
+        table.base = list.data();
+        table.count = list.size();
+    }
+
+    void resolve_entities();
+
+    constexpr static size_t invalid_entity_id = std::numeric_limits<size_t>::max();
+    std::vector<EntityTable> entity_tables;
+
+    /// @brief While alive, objects are being deserialized onto temporaries which are moved
+    /// afterwards (i.e the keys and values of sets and maps), so their address can't be
+    /// recorded to resolve pointers later
+    struct TemporaryScope {
+        TemporaryScope(Archive& _ar)
+            : ar{ _ar }
+        {
+            ar.n_temporaries++;
+        }
+        ~TemporaryScope() {
+            ar.n_temporaries--;
+        }
+        Archive& ar;
+    };
+    size_t n_temporaries = 0;
+
+    /// @brief Obtains the index of the string on the string table, adding it if it's
+    /// not there yet, index 0 is reserved for the invalid reference
+    inline uint32_t get_string_index(Eng3D::StringRef ref) {
+        if(ref.id == invalid_string_id) return 0;
+        const auto [it, inserted] = string_indices.try_emplace(ref.id, string_table.size() + 1);
+        if(inserted) string_table.push_back(ref);
+        return it->second;
+    }
+    /// @brief Appends the string table to the buffer, required before sending an archive
+    /// with string references anywhere but to a file
+    void write_string_table();
+    /// @brief Strips the string table off the end of a buffer given by set_buffer
+    void read_string_table();
+
+    constexpr static size_t invalid_string_id = static_cast<size_t>(-1);
+    /// @brief Strings referenced by the archive, on save they're written once at the end
+    /// of the stream and on load they're interned in bulk before deserializing
+    std::vector<Eng3D::StringRef> string_table;
+    std::unordered_map<size_t, uint32_t> string_indices;
+
     std::vector<uint8_t> buffer;
     size_t ptr = 0;
 };
 
+/// @brief A named archive stored inside a sectioned archive file
+struct ArchiveSection {
+    std::string name;
+    /// @brief Offset of the (compressed) payload from the start of the file
+    uint64_t offset = 0;
+    /// @brief Uncompressed size
+    uint32_t inf_len = 0;
+    /// @brief Compressed size
+    uint32_t def_len = 0;
+    /// @brief Checksum of the compressed payload
+    uint32_t checksum = 0;
+    /// @brief Whetever the payload ends with the string table of the archive
+    bool has_string_table = false;
+    /// @brief Codec the payload is compressed with
+    Eng3D::Compression::Codec codec = Eng3D::Compression::Codec::NONE;
+    /// @brief Contents of the section, only valid once it has been loaded
+    Archive archive;
+    bool loaded = false;
+};
+
+/// @brief A file made of multiple named archives (sections), each one compressed on its own
+/// and indexed by a table at the start of the file. Opening the file only reads the table,
+/// so subsystems can load just the sections they need (in parallel if wanted), and tools can
+/// inspect the file without loading it entirely
+struct SectionedArchive {
+    SectionedArchive() = default;
+    ~SectionedArchive() = default;
+    Archive& add_section(const std::string& name);
+    void to_file(const std::string& path);
+    std::shared_ptr<ArchiveSaveTask> to_file_async(const std::string& path, std::function<void(const ArchiveSaveTask&)> callback = nullptr);
+    void open(const std::string& path);
+    Archive& load_section(const std::string& name);
+    void load_all();
+
+    /// @brief Obtains a section by it's name
+    /// @return ArchiveSection* The section, nullptr if it doesn't exist
+    inline ArchiveSection* find_section(const std::string_view name) {
+        for(auto& section : sections)
+            if(section.name == name)
+                return &section;
+        return nullptr;
+    }
+
+    /// @brief Path of the file the table was read from, used to lazily load sections
+    std::string path;
+    /// @brief Deque so references to the archives remain valid when adding sections
+    std::deque<ArchiveSection> sections;
+};
+
+/// @brief A pending save of an archive onto the disk, it's shared between the thread
+/// that requested it and the saving thread, so the UI can poll the progress of it
+struct ArchiveSaveTask {
+    enum class Status {
+        PENDING,
+        COMPRESSING,
+        WRITING,
+        DONE,
+        FAILED,
+    };
+
+    ArchiveSaveTask() = default;
+    ~ArchiveSaveTask() = default;
+    void wait();
+
+    /// @brief Whetever the task has finished, regardless if it succeeded or not
+    inline bool is_done() const {
+        const auto st = status.load();
+        return st == Status::DONE || st == Status::FAILED;
+    }
+
+    std::string path;
+    /// @brief Snapshot of the archive(s), owned by the task until it's written
+    SectionedArchive archive;
+    std::atomic<Status> status = Status::PENDING;
+    /// @brief Progress of the save, from 0 to 1
+    std::atomic<float> progress = 0.f;
+    /// @brief Error message, only valid when status is FAILED
+    std::string error;
+    /// @brief Called from the saving thread once the task is done
+    std::function<void(const ArchiveSaveTask&)> callback;
+};
+
 template<bool is_const, typename T>
 struct CondConstType;
 template<typename T>
@@ -166,9 +466,34 @@ struct SerializerMemcpy {
 
 template<typename T>
 concept SerializerScalar = std::is_integral_v<T> || std::is_floating_point_v<T>;
+/// @brief (De)-serializes a floating point value as a fixed point integer, useful for
+/// values whose range and precision are known beforehand (i.e network snapshots)
+/// @param scale Multiplier applied before rounding into an integer
+/// @param bits Width of the stored integer, values outside the range are clamped
+template<bool is_serialize, typename T>
+inline void deser_quantized(Archive& ar, T& obj, float scale, unsigned bits) {
+    static_assert(std::is_floating_point_v<std::remove_const_t<T>>);
+    const auto max = static_cast<int64_t>((uint64_t(1) << (std::clamp(bits, 2U, 32U) - 1)) - 1);
+    const auto quantize = [&]() {
+        return static_cast<int32_t>(std::clamp<int64_t>(std::llround(obj * scale), -max - 1, max));
+    };
+    if(bits <= 8) {
+        auto tmp = static_cast<int8_t>(is_serialize ? quantize() : 0);
+        ::deser_dynamic<is_serialize>(ar, tmp);
+        if constexpr(!is_serialize) obj = static_cast<T>(tmp) / scale;
+    } else if(bits <= 16) {
+        auto tmp = static_cast<int16_t>(is_serialize ? quantize() : 0);
+        ::deser_dynamic<is_serialize>(ar, tmp);
+        if constexpr(!is_serialize) obj = static_cast<T>(tmp) / scale;
+    } else {
+        auto tmp = is_serialize ? quantize() : 0;
+        ::deser_dynamic<is_serialize>(ar, tmp);
+        if constexpr(!is_serialize) obj = static_cast<T>(tmp) / scale;
+    }
+}
+
 template<SerializerScalar T>
 class Serializer<T> {
-    constexpr static auto scaling = 1000.f;
 public:
     template<bool is_const>
     using type = CondConstType<is_const, T>::type;
@@ -176,20 +501,90 @@ public:
     template<bool is_serialize>
     static inline void deser_dynamic(Archive& ar, type<is_serialize>& obj) {
         if constexpr(std::is_floating_point_v<T>) {
-            auto tmp = static_cast<int32_t>(obj * scaling);
-            ::deser_dynamic<is_serialize>(ar, tmp);
+            if(ar.float_mode == Archive::FloatMode::QUANTIZED) {
+                ::deser_quantized<is_serialize>(ar, obj, ar.float_scale, ar.float_bits);
+                return;
+            }
+            using U = std::conditional_t<sizeof(T) == sizeof(uint64_t), uint64_t, uint32_t>;
+            static_assert(sizeof(T) == sizeof(U));
+            U tmp{};
+            if constexpr(is_serialize)
+                tmp = std::bit_cast<U>(obj);
+            if(is_serialize && ar.is_swapped())
+                tmp = std::byteswap<U>(tmp);
+            SerializerMemcpy<U>::template deser_dynamic<is_serialize>(ar, tmp);
+            if(!is_serialize && ar.is_swapped())
+                tmp = std::byteswap<U>(tmp);
             if constexpr(!is_serialize)
-                obj = static_cast<T>(tmp) * (1.f / scaling);
+                obj = std::bit_cast<T>(tmp);
+        } else if(sizeof(T) > 1 && ar.int_mode == Archive::IntMode::VARINT) {
+            if constexpr(is_serialize) {
+                ar.write_varint(Archive::zigzag(obj));
+            } else {
+                const auto value = ar.read_varint();
+                if constexpr(std::is_signed_v<T>) {
+                    const auto n = static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+                    if(n < std::numeric_limits<T>::min() || n > std::numeric_limits<T>::max())
+                        CXX_THROW(SerializerException, "Varint out of range for integer type");
+                    obj = static_cast<T>(n);
+                } else {
+                    if(value > std::numeric_limits<T>::max())
+                        CXX_THROW(SerializerException, "Varint out of range for integer type");
+                    obj = static_cast<T>(value);
+                }
+            }
+        } else if(sizeof(T) > 1 && ar.is_swapped()) {
+            T tmp = obj;
+            if constexpr(is_serialize)
+                tmp = std::byteswap<T>(tmp);
+            SerializerMemcpy<T>::template deser_dynamic<is_serialize>(ar, tmp);
+            if constexpr(!is_serialize)
+                obj = std::byteswap<T>(tmp);
         } else {
-            if constexpr(is_serialize && std::endian::native == std::endian::big)
-                obj = std::byteswap<T>(obj);
             SerializerMemcpy<T>::template deser_dynamic<is_serialize>(ar, obj);
-            if constexpr(!is_serialize && std::endian::native == std::endian::big)
-                obj = std::byteswap<T>(obj);
         }
     }
 };
 
+template<typename T>
+constexpr bool serializer_is_bitset = false;
+template<size_t bits>
+constexpr bool serializer_is_bitset<std::bitset<bits>> = true;
+
+/// @brief Whetever T can be copied as-is onto the stream. Aggregates opt-in by specializing
+/// this to true, which is only correct when they hold plain values: pointers and string
+/// references have to be remapped by their serializer
+template<typename T>
+constexpr bool serializer_is_memcpy = std::is_arithmetic_v<T> || std::is_enum_v<T>;
+
+/// @brief Whetever a contiguous array of T can be copied as-is from/onto the stream,
+/// given the encoding settings of the archive
+template<typename T>
+inline bool serializer_is_bulk(const Archive& ar) {
+    if constexpr(!std::is_trivially_copyable_v<T> || !(serializer_is_memcpy<T> || serializer_is_bitset<T>))
+        return false;
+    else if constexpr(std::is_integral_v<T> && sizeof(T) > 1)
+        return ar.int_mode == Archive::IntMode::FIXED && !ar.is_swapped();
+    else if constexpr(std::is_floating_point_v<T>)
+        return ar.float_mode == Archive::FloatMode::RAW && !ar.is_swapped();
+    else if constexpr(serializer_is_bitset<T>)
+        return Serializer<T>::is_packed;
+    else // Aggregates may hold wider fields which would need swapping
+        return sizeof(T) == 1 || !ar.is_swapped();
+}
+
+/// @brief Whetever a contiguous array of T can be copied from/onto the stream in one go
+/// swapping the byte order of every element
+template<typename T>
+inline bool serializer_is_bulk_swapped(const Archive& ar) {
+    if constexpr(std::is_integral_v<T> && (sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8))
+        return ar.int_mode == Archive::IntMode::FIXED && ar.is_swapped();
+    else if constexpr(std::is_floating_point_v<T> && (sizeof(T) == 4 || sizeof(T) == 8))
+        return ar.float_mode == Archive::FloatMode::RAW && ar.is_swapped();
+    else
+        return false;
+}
+
 template<typename T>
 concept SerializerContainer = requires(T a, T b) {
     requires std::destructible<typename T::value_type>;
@@ -212,12 +607,23 @@ struct Serializer<T> {
         if(!len) return; // Early exit iff nothing to do
 
         if constexpr(is_serialize) {
-            if constexpr(has_data && std::is_trivially_copyable<typename T::value_type>::value) {
-                ar.copy_from(obj_group.data(), len * sizeof(typename T::value_type));
-            } else { // non-trivial
-                for(auto& obj : obj_group)
-                    ::deser_dynamic<true>(ar, obj);
+            if constexpr(has_data) {
+                if(serializer_is_bulk<typename T::value_type>(ar)) {
+                    ar.copy_from(obj_group.data(), len * sizeof(typename T::value_type));
+                    return;
+                } else if(serializer_is_bulk_swapped<typename T::value_type>(ar)) {
+                    ar.copy_from_swapped(obj_group.data(), len, sizeof(typename T::value_type));
+                    return;
+                }
+                if constexpr(std::is_integral_v<typename T::value_type> && sizeof(typename T::value_type) > 1) {
+                    if(ar.int_mode == Archive::IntMode::VARINT) {
+                        ar.write_varints(obj_group.data(), len);
+                        return;
+                    }
+                }
             }
+            for(auto& obj : obj_group)
+                ::deser_dynamic<true>(ar, obj);
         } else {
             // No insert means this is a static array of some sort, std::array perhaps?
             constexpr bool has_insert = requires(T a, typename T::value_type tp) { a.insert(tp); };
@@ -230,27 +636,92 @@ struct Serializer<T> {
 
             if constexpr(has_resize) {
                 obj_group.resize(len);
-                if constexpr(has_data && std::is_trivially_copyable<typename T::value_type>::value) {
-                    ar.copy_to(obj_group.data(), len * sizeof(typename T::value_type));
-                } else { // non-len
-                    for(decltype(len) i = 0; i < len; i++)
-                        ::deser_dynamic<false>(ar, obj_group[i]);
+                if constexpr(has_data) {
+                    if(serializer_is_bulk<typename T::value_type>(ar)) {
+                        ar.copy_to(obj_group.data(), len * sizeof(typename T::value_type));
+                        return;
+                    } else if(serializer_is_bulk_swapped<typename T::value_type>(ar)) {
+                        ar.copy_to_swapped(obj_group.data(), len, sizeof(typename T::value_type));
+                        return;
+                    }
                 }
+                for(auto& obj : obj_group) // Also works for lists
+                    ::deser_dynamic<false>(ar, obj);
             } else { // non-len, no resize
+                if constexpr(requires(T a, size_t n) { a.reserve(n); })
+                    obj_group.reserve(len); // Avoid rehashing on unordered containers
+                const Archive::TemporaryScope temporaries(ar);
                 for(decltype(len) i = 0; i < len; i++) {
                     typename T::value_type obj{}; // Initialized but then overwritten by the deserializer
                     ::deser_dynamic<false>(ar, obj);
-                    constexpr bool has_push_back = requires(T a, typename T::value_type tp) { a.push_back(tp); };
-                    if constexpr(has_push_back)
-                        obj_group.push_back(obj);
+                    constexpr bool has_emplace_back = requires(T a, typename T::value_type tp) { a.emplace_back(std::move(tp)); };
+                    constexpr bool has_emplace_hint = requires(T a, typename T::value_type tp) { a.emplace_hint(a.end(), std::move(tp)); };
+                    if constexpr(has_emplace_back)
+                        obj_group.emplace_back(std::move(obj));
+                    else if constexpr(has_emplace_hint) // Elements were stored in order, so they go at the end
+                        obj_group.emplace_hint(obj_group.end(), std::move(obj));
                     else if constexpr(has_insert)
-                        obj_group.insert(obj);
+                        obj_group.insert(std::move(obj));
                 }
             }
         }
     }
 };
 
+template<typename T>
+concept SerializerMap = SerializerContainer<T> && requires {
+    typename T::key_type;
+    typename T::mapped_type;
+};
+/// @brief Associative containers (std::map, std::unordered_map and friends), stored
+/// like a container of pairs, the key and value are deserialized onto a mutable pair
+/// and then moved onto the node
+template<SerializerMap T>
+struct Serializer<T> {
+    template<bool is_const>
+    using type = CondConstType<is_const, T>::type;
+
+    template<bool is_serialize>
+    static inline void deser_dynamic(Archive& ar, type<is_serialize>& obj_group) {
+        uint32_t len = obj_group.size();
+        ::deser_dynamic<is_serialize>(ar, len);
+        if constexpr(is_serialize) {
+            for(const auto& [key, value] : obj_group) {
+                ::deser_dynamic<true>(ar, key);
+                ::deser_dynamic<true>(ar, value);
+            }
+        } else {
+            if constexpr(requires(T a, size_t n) { a.reserve(n); })
+                obj_group.reserve(len);
+            const Archive::TemporaryScope temporaries(ar);
+            for(decltype(len) i = 0; i < len; i++) {
+                typename T::key_type key{};
+                ::deser_dynamic<false>(ar, key);
+                typename T::mapped_type value{};
+                ::deser_dynamic<false>(ar, value);
+                obj_group.emplace_hint(obj_group.end(), std::piecewise_construct,
+                    std::forward_as_tuple(std::move(key)), std::forward_as_tuple(std::move(value)));
+            }
+        }
+    }
+};
+
+/// @brief Enums are stored as their underlying type
+template<typename T>
+requires std::is_enum_v<T>
+struct Serializer<T> {
+    template<bool is_const>
+    using type = CondConstType<is_const, T>::type;
+
+    template<bool is_serialize>
+    static inline void deser_dynamic(Archive& ar, type<is_serialize>& obj) {
+        auto tmp = static_cast<std::underlying_type_t<T>>(obj);
+        ::deser_dynamic<is_serialize>(ar, tmp);
+        if constexpr(!is_serialize)
+            obj = static_cast<T>(tmp);
+    }
+};
+
 /// @todo On some compilers a boolean can be something not a uint8_t, we should
 // explicitly recast this boolean into a uint8_t to avoid problems
 template<>
@@ -269,27 +740,112 @@ struct Serializer<std::pair<T, U>> {
     }
 };
 
-#include <bitset>
-template<typename T, int N>
-struct SerializerBitset {
+/// @brief Bitsets are stored as packed little-endian 64-bit words. On little-endian targets
+/// where the bitset is made of whole words (true for the common standard libraries) the
+/// object is copied directly with a single memcpy
+template<size_t bits>
+struct Serializer<std::bitset<bits>> {
     template<bool is_const>
-    using type = CondConstType<is_const, T>::type;
+    using type = CondConstType<is_const, std::bitset<bits>>::type;
+    constexpr static size_t n_words = (bits + 63) / 64;
+    constexpr static bool is_packed = std::endian::native == std::endian::little
+        && std::is_trivially_copyable_v<std::bitset<bits>> && sizeof(std::bitset<bits>) == n_words * sizeof(uint64_t);
 
     template<bool is_serialize>
-    static inline void deser_dynamic(Archive& ar, type<is_serialize>& obj_group) {
-        unsigned long num = obj_group.to_ulong();
+    static inline void deser_dynamic(Archive& ar, type<is_serialize>& obj) {
+        if constexpr(is_packed) {
+            if constexpr(is_serialize) {
+                ar.copy_from(&obj, sizeof(obj));
+            } else {
+                ar.copy_to(&obj, sizeof(obj));
+                if constexpr(bits % 64) { // Padding bits must stay cleared
+                    uint64_t last;
+                    auto* p = reinterpret_cast<uint8_t*>(&obj) + (n_words - 1) * sizeof(uint64_t);
+                    std::memcpy(&last, p, sizeof(last));
+                    last &= (uint64_t(1) << (bits % 64)) - 1;
+                    std::memcpy(p, &last, sizeof(last));
+                }
+            }
+        } else {
+            std::array<uint64_t, n_words> words{};
+            if constexpr(is_serialize) {
+                for(size_t i = 0; i < bits; i++)
+                    words[i / 64] |= static_cast<uint64_t>(obj[i]) << (i % 64);
+                if constexpr(std::endian::native == std::endian::big)
+                    for(auto& word : words) word = std::byteswap(word);
+                ar.copy_from(words.data(), sizeof(words));
+            } else {
+                ar.copy_to(words.data(), sizeof(words));
+                if constexpr(std::endian::native == std::endian::big)
+                    for(auto& word : words) word = std::byteswap(word);
+                for(size_t i = 0; i < bits; i++)
+                    obj[i] = (words[i / 64] >> (i % 64)) & 1;
+            }
+        }
+    }
+};
+
+/// @brief Packed serializer for boolean vectors, the length (in bits) followed by
+/// the bits packed into little-endian 64-bit words, copied as one block
+template<typename A>
+struct Serializer<std::vector<bool, A>> {
+    template<bool is_const>
+    using type = CondConstType<is_const, std::vector<bool, A>>::type;
+#ifdef __GLIBCXX__
+    // libstdc++ stores the bits LSB first onto machine words, same layout as the stream
+    constexpr static bool has_words = sizeof(std::_Bit_type) == sizeof(uint64_t) && std::endian::native == std::endian::little;
+#else
+    constexpr static bool has_words = false;
+#endif
+
+    template<bool is_serialize>
+    static inline void deser_dynamic(Archive& ar, type<is_serialize>& obj) {
+        uint32_t len = obj.size();
+        ::deser_dynamic<is_serialize>(ar, len);
+        const size_t n_words = (static_cast<size_t>(len) + 63) / 64;
+        const uint64_t padding_mask = (len % 64) ? (uint64_t(1) << (len % 64)) - 1 : ~uint64_t(0);
         if constexpr(is_serialize) {
-            ::deser_dynamic<is_serialize>(ar, num);
+            if(!len) return;
+            if constexpr(has_words) {
+                const auto* words = obj.begin()._M_p;
+                ar.copy_from(words, (n_words - 1) * sizeof(uint64_t));
+                const uint64_t last = words[n_words - 1] & padding_mask; // Bits past the end are unspecified
+                ar.copy_from(&last, sizeof(last));
+            } else {
+                std::vector<uint64_t> words(n_words);
+                for(size_t i = 0; i < len; i++)
+                    words[i / 64] |= static_cast<uint64_t>(obj[i]) << (i % 64);
+                if constexpr(std::endian::native == std::endian::big)
+                    for(auto& word : words) word = std::byteswap(word);
+                ar.copy_from(words.data(), n_words * sizeof(uint64_t));
+            }
         } else {
-            ::deser_dynamic<is_serialize>(ar, num);
-            obj_group = T(num);
+            // Checked before allocating, a corrupted length could ask for gigabytes
+            if(n_words * sizeof(uint64_t) > ar.buffer.size() - ar.ptr)
+                CXX_THROW(SerializerException, "Boolean vector is larger than the archive");
+            obj.clear();
+            if(!len) return;
+            obj.resize(len);
+            if constexpr(has_words) {
+                auto* words = obj.begin()._M_p;
+                ar.copy_to(words, n_words * sizeof(uint64_t));
+                words[n_words - 1] &= padding_mask;
+            } else {
+                std::vector<uint64_t> words(n_words);
+                ar.copy_to(words.data(), n_words * sizeof(uint64_t));
+                if constexpr(std::endian::native == std::endian::big)
+                    for(auto& word : words) word = std::byteswap(word);
+                for(size_t i = 0; i < len; i++)
+                    obj[i] = (words[i / 64] >> (i % 64)) & 1;
+            }
         }
     }
 };
-template<size_t bits>
-struct Serializer<std::bitset<bits>> : SerializerBitset<std::bitset<bits>, bits> {};
 
-#include "eng3d/string.hpp"
+/// @brief String references are stored as an index onto the string table of the archive,
+/// so the archive doesn't depend on the string ids of the process that saved it. Types
+/// holding them need a Serializer of their own (they're never memcpy'd), and in-memory
+/// archives must carry the table explicitly, see Archive::get_buffer
 template<>
 struct Serializer<Eng3D::StringRef> {
     template<bool is_const>
@@ -297,7 +853,14 @@ struct Serializer<Eng3D::StringRef> {
 
     template<bool is_serialize>
     static inline void deser_dynamic(Archive& ar, type<is_serialize>& obj) {
-        ::deser_dynamic<is_serialize>(ar, obj.id);
+        if constexpr(is_serialize) {
+            ar.write_varint(ar.get_string_index(obj));
+        } else {
+            const auto index = ar.read_varint();
+            if(index > ar.string_table.size())
+                CXX_THROW(SerializerException, ar.string_table.empty() ? "String reference without a string table (missing read_string_table?)" : "String index out of range");
+            obj = index ? ar.string_table[index - 1] : Eng3D::StringRef(Archive::invalid_string_id);
+        }
     }
 };
 
@@ -316,4 +879,50 @@ struct Serializer<Eng3D::Rectangle> {
     }
 };
 
-/// @todo Template for entities
+#include "eng3d/entity.hpp"
+template<std::unsigned_integral T>
+constexpr bool serializer_is_memcpy<EntityId<T>> = true;
+template<std::unsigned_integral T>
+struct Serializer<EntityId<T>> {
+    template<bool is_const>
+    using type = CondConstType<is_const, EntityId<T>>::type;
+
+    template<bool is_serialize>
+    static inline void deser_dynamic(Archive& ar, type<is_serialize>& obj) {
+        ::deser_dynamic<is_serialize>(ar, obj.id);
+    }
+};
+
+template<typename T>
+concept SerializerEntity = requires { typename T::Id; } && std::derived_from<T, Entity<typename T::Id>>;
+/// @brief Pointers to entities are stored as the id of the entity. When deserializing, the
+/// pointers are resolved right away if the list of entities is registered already, otherwise
+/// they're recorded and then resolved all at once by Archive::resolve_entities, once the
+/// entity lists have been loaded and registered with Archive::register_entities. Pointers
+/// held by sets and maps are deserialized onto temporaries, so their entities must be
+/// registered beforehand
+template<SerializerEntity T>
+struct Serializer<T*> {
+    template<bool is_const>
+    using type = CondConstType<is_const, T*>::type;
+
+    template<bool is_serialize>
+    static inline void deser_dynamic(Archive& ar, type<is_serialize>& obj) {
+        auto id = (obj != nullptr) ? obj->cached_id : T::invalid();
+        ::deser_dynamic<is_serialize>(ar, id);
+        if constexpr(!is_serialize) {
+            obj = nullptr;
+            auto& table = ar.get_entity_table<std::remove_const_t<T>>();
+            const size_t entity_id = T::is_invalid(id) ? Archive::invalid_entity_id : static_cast<size_t>(id);
+            if(table.base != nullptr) {
+                if(entity_id != Archive::invalid_entity_id && entity_id >= table.count)
+                    CXX_THROW(SerializerException, string_format("Entity id %zu out of bounds (%zu entities)", entity_id, table.count));
+                table.assign(&obj, table.base, entity_id);
+            } else if(ar.n_temporaries) {
+                CXX_THROW(SerializerException, "Entities pointed to from sets or maps must be registered before deserializing them");
+            } else {
+                table.fixups.push_back(Archive::EntityFixup{ &obj, entity_id });
+            }
+        }
+    }
+};
@@ -26,6 +26,7 @@
 #include <iostream>
 #include <sstream>
 #include <cassert>
+#include <algorithm>
 
 #ifdef E3D_BACKEND_OPENGL
 #   include <GL/glew.h>
@@ -42,12 +43,25 @@
 #if defined E3D_BACKEND_OPENGL || defined E3D_BACKEND_GLES
 /// @brief Construct a shader by opening the provided path and creating a temporal ifstream, reading
 /// from that stream in text mode and then compiling the shader
-Eng3D::OpenGL::Shader::Shader(const std::string& _buffer, GLuint type, bool use_transpiler, std::vector<Eng3D::GLSL::Define> defintions)
-    : buffer(_buffer)
+Eng3D::OpenGL::Shader::Shader(std::string_view _buffer, GLuint _type, bool _use_transpiler, std::vector<Eng3D::GLSL::Define> defintions)
+    : type{ _type },
+    use_transpiler{ _use_transpiler },
+    definitions{ defintions }
 {
+    id = glCreateShader(type);
+    if(!id)
+        CXX_THROW(Eng3D::ShaderException, "Can't create shader");
+    set_source(_buffer);
+    compile(type);
+}
+
+/// @brief Gives the source to the shader object, preprocessed by the transpiler if asked to
+void Eng3D::OpenGL::Shader::set_source(std::string_view _buffer) {
+    buffer = _buffer;
+    line_numbers.clear();
     if(use_transpiler) {
         Eng3D::GLSL::Context ctx(buffer);
-        ctx.defines = defintions;
+        ctx.defines = definitions;
         ctx.lexer();
         try {
             ctx.parser();
@@ -58,12 +72,29 @@ Eng3D::OpenGL::Shader::Shader(const std::string& _buffer, GLuint type, bool use_
         line_numbers = ctx.line_numbers;
     }
 
-    id = glCreateShader(type);
-    if(!id)
-        CXX_THROW(Eng3D::ShaderException, "Can't create shader");
     const char* c_code = buffer.c_str();
     glShaderSource(id, 1, &c_code, NULL);
-    compile(type);
+}
+
+/// @brief Compiles the shader again from a new source, keeping the same object so the programs
+/// it is attached to only have to be relinked (which is done here too). If the new source does
+/// not compile the previous one is restored before throwing
+/// @param _buffer The new source
+void Eng3D::OpenGL::Shader::reload(std::string_view _buffer) {
+    auto prev_buffer = std::move(buffer);
+    auto prev_line_numbers = std::move(line_numbers);
+    set_source(_buffer);
+    try {
+        compile(type);
+    } catch(const Eng3D::ShaderException&) {
+        buffer = std::move(prev_buffer);
+        line_numbers = std::move(prev_line_numbers);
+        const char* c_code = buffer.c_str();
+        glShaderSource(id, 1, &c_code, NULL);
+        compile(type);
+        throw;
+    }
+    Eng3D::OpenGL::Program::relink(*this);
 }
 
 #include <sstream>
@@ -139,7 +170,7 @@ unsigned int Eng3D::OpenGL::Shader::get_id() const {
 //
 // Vertex shader
 //
-Eng3D::OpenGL::VertexShader::VertexShader(const std::string& _buffer)
+Eng3D::OpenGL::VertexShader::VertexShader(std::string_view _buffer)
     : Eng3D::OpenGL::Shader(_buffer, GL_VERTEX_SHADER)
 {
 
@@ -148,7 +179,7 @@ Eng3D::OpenGL::VertexShader::VertexShader(const std::string& _buffer)
 //
 // Fragment shader
 //
-Eng3D::OpenGL::FragmentShader::FragmentShader(const std::string& _buffer, bool use_transpiler, std::vector<Eng3D::GLSL::Define> defintions)
+Eng3D::OpenGL::FragmentShader::FragmentShader(std::string_view _buffer, bool use_transpiler, std::vector<Eng3D::GLSL::Define> defintions)
     : Eng3D::OpenGL::Shader(_buffer, GL_FRAGMENT_SHADER, use_transpiler, defintions)
 {
 
@@ -158,7 +189,7 @@ Eng3D::OpenGL::FragmentShader::FragmentShader(const std::string& _buffer, bool u
 //
 // Geometry shader
 //
-Eng3D::OpenGL::GeometryShader::GeometryShader(const std::string& _buffer)
+Eng3D::OpenGL::GeometryShader::GeometryShader(std::string_view _buffer)
     : Eng3D::OpenGL::Shader(_buffer, GL_GEOMETRY_SHADER)
 {
 
@@ -167,7 +198,7 @@ Eng3D::OpenGL::GeometryShader::GeometryShader(const std::string& _buffer)
 //
 // Tesseleation control shader
 //
-Eng3D::OpenGL::TessControlShader::TessControlShader(const std::string& _buffer)
+Eng3D::OpenGL::TessControlShader::TessControlShader(std::string_view _buffer)
     : Eng3D::OpenGL::Shader(_buffer, GL_TESS_CONTROL_SHADER)
 {
 
@@ -176,7 +207,7 @@ Eng3D::OpenGL::TessControlShader::TessControlShader(const std::string& _buffer)
 //
 // Tesselation evaluation shader
 //
-Eng3D::OpenGL::TessEvalShader::TessEvalShader(const std::string& _buffer)
+Eng3D::OpenGL::TessEvalShader::TessEvalShader(std::string_view _buffer)
     : Eng3D::OpenGL::Shader(_buffer, GL_TESS_EVALUATION_SHADER)
 {
 
@@ -186,16 +217,22 @@ Eng3D::OpenGL::TessEvalShader::TessEvalShader(const std::string& _buffer)
 //
 // Program shader
 //
+
+/// @brief Programs that are alive, so the ones a reloaded shader is attached to can be relinked
+static std::vector<Eng3D::OpenGL::Program*> programs;
+
 Eng3D::OpenGL::Program::Program() {
     id = glCreateProgram();
     if(!id)
         CXX_THROW(Eng3D::ShaderException, "Can't create new shader program");
     glBindAttribLocation(id, 0, "m_pos");
     glBindAttribLocation(id, 1, "m_texcoord");
+    programs.push_back(this);
 }
 
 Eng3D::OpenGL::Program::~Program() {
     glDeleteProgram(id);
+    std::erase(programs, this);
 }
 
 /// @brief Links the whole program into itself, all attached shaders that were
@@ -222,6 +259,21 @@ void Eng3D::OpenGL::Program::link() {
 /// @param shader Shader to attach
 void Eng3D::OpenGL::Program::attach_shader(const Eng3D::OpenGL::Shader& shader) {
     glAttachShader(id, shader.get_id());
+    shader_ids.push_back(shader.get_id());
+}
+
+/// @brief Links again the programs that have the given shader attached, used after the shader
+/// is reloaded so the programs pick its new source
+/// @param shader The reloaded shader
+void Eng3D::OpenGL::Program::relink(const Eng3D::OpenGL::Shader& shader) {
+    size_t n_relinked = 0;
+    for(auto* program : programs) {
+        if(std::find(program->shader_ids.begin(), program->shader_ids.end(), shader.get_id()) == program->shader_ids.end())
+            continue;
+        program->link();
+        n_relinked++;
+    }
+    Eng3D::Log::debug("shader", Eng3D::translate_format("Relinked %zu programs", n_relinked));
 }
 
 void Eng3D::OpenGL::Program::use() const {
@@ -270,7 +322,7 @@ void Eng3D::OpenGL::Program::set_uniform(const std::string& name, int value) con
 void Eng3D::OpenGL::Program::set_texture(int value, const std::string& name, const Eng3D::Texture& texture) const {
     glActiveTexture(GL_TEXTURE0 + value);
     set_uniform(name, value);
-    glBindTexture(GL_TEXTURE_2D, texture.id);
+    texture.bind();
 }
 
 void Eng3D::OpenGL::Program::set_texture(int value, const std::string& name, const Eng3D::TextureArray& texture) const {
@@ -26,6 +26,7 @@
 
 #include <cassert>
 #include <string>
+#include <string_view>
 #include <exception>
 
 #include <glm/gtc/type_ptr.hpp>
@@ -69,55 +70,62 @@ namespace Eng3D {
         /// @brief OpenGL shader object
         class Shader {
         private:
+            void set_source(std::string_view _buffer);
             void compile(unsigned int type);
             std::string buffer;
             unsigned int id;
+            unsigned int type;
+            bool use_transpiler;
+            std::vector<Eng3D::GLSL::Define> definitions;
             std::vector<int> line_numbers;
         public:
-            Shader(const std::string& _buffer, unsigned int type, bool use_transpiler = true, std::vector<Eng3D::GLSL::Define> defintions = {});
+            Shader(std::string_view _buffer, unsigned int type, bool use_transpiler = true, std::vector<Eng3D::GLSL::Define> defintions = {});
             ~Shader();
+            void reload(std::string_view _buffer);
             unsigned int get_id() const;
         };
 
         class VertexShader: public Shader {
         public:
-            VertexShader(const std::string& _buffer);
+            VertexShader(std::string_view _buffer);
             ~VertexShader() = default;
         };
 
         class FragmentShader: public Shader {
         public:
-            FragmentShader(const std::string& _buffer, bool use_transpiler = true, std::vector<Eng3D::GLSL::Define> defintions = {});
+            FragmentShader(std::string_view _buffer, bool use_transpiler = true, std::vector<Eng3D::GLSL::Define> defintions = {});
             ~FragmentShader() = default;
         };
 
 #if !defined E3D_BACKEND_GLES
         class GeometryShader: public Shader {
         public:
-            GeometryShader(const std::string& _buffer);
+            GeometryShader(std::string_view _buffer);
             ~GeometryShader() = default;
         };
 
         class TessControlShader: public Shader {
         public:
-            TessControlShader(const std::string& _buffer);
+            TessControlShader(std::string_view _buffer);
             ~TessControlShader() = default;
         };
 
         class TessEvalShader: public Shader {
         public:
-            TessEvalShader(const std::string& _buffer);
+            TessEvalShader(std::string_view _buffer);
             ~TessEvalShader() = default;
         };
 #endif
 
         class Program {
             unsigned int id;
+            std::vector<unsigned int> shader_ids; // Attached shaders
         public:
             Program();
             ~Program();
             void link();
             void attach_shader(const Eng3D::OpenGL::Shader& shader);
+            static void relink(const Eng3D::OpenGL::Shader& shader);
             void use() const;
             void set_uniform(const std::string& name, glm::mat4 uniform) const;
             void set_uniform(const std::string& name, float value1, float value2) const;
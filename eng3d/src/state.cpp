@@ -354,40 +354,105 @@ Eng3D::State::~State() {
     this->run = false;
 }
 
-void Eng3D::State::reload_shaders() {
-    // Compile built-in shaders
-    const auto read_file = [this](const std::string& file_name) {
-        return this->package_man.get_unique("shaders/" + file_name)->read_all();
-    };
-    const auto load_fragment_shader = [read_file](std::string file_name) {
-        return std::make_unique<Eng3D::OpenGL::FragmentShader>(read_file(file_name));
-    };
-    const auto load_vertex_shader = [read_file](std::string file_name) {
-        return std::make_unique<Eng3D::OpenGL::VertexShader>(read_file(file_name));
-    };
-
-    builtin_shaders.clear();
 #if defined E3D_BACKEND_OPENGL || defined E3D_BACKEND_GLES
+struct BuiltinShader {
+    std::string_view name;
+    std::string_view file_name;
+    bool is_vertex;
+};
+static constexpr BuiltinShader builtin_shader_files[] = {
     // Big library used mostly by every shader, compiled for faster linking or other stuff
-    builtin_shaders["fs_lib"] = load_fragment_shader("lib.fs");
+    { "fs_lib", "lib.fs", false },
     // 2D generic fragment shader
-    builtin_shaders["fs_2d"] = load_fragment_shader("2d.fs");
+    { "fs_2d", "2d.fs", false },
     // 2D generic vertex shader
-    builtin_shaders["vs_2d"] = load_vertex_shader("2d.vs");
+    { "vs_2d", "2d.vs", true },
     // 3D generic fragment shader
-    builtin_shaders["fs_3d"] = load_fragment_shader("3d.fs");
+    { "fs_3d", "3d.fs", false },
     // 3D generic vertex shader
-    builtin_shaders["vs_3d"] = load_vertex_shader("3d.vs");
+    { "vs_3d", "3d.vs", true },
     // 3D tree fragment shader
-    builtin_shaders["fs_tree"] = load_fragment_shader("tree.fs");
+    { "fs_tree", "tree.fs", false },
     // 3D tree vertex shader
-    builtin_shaders["vs_tree"] = load_vertex_shader("tree.vs");
-    builtin_shaders["vs_font_sdf"] = load_vertex_shader("font_sdf.vs");
-    builtin_shaders["fs_font_sdf"] = load_fragment_shader("font_sdf.fs");
+    { "vs_tree", "tree.vs", true },
+    { "vs_font_sdf", "font_sdf.vs", true },
+    { "fs_font_sdf", "font_sdf.fs", false },
     // 2D Piechart shaders
-    builtin_shaders["vs_piechart"] = load_vertex_shader("piechart.vs");
-    builtin_shaders["fs_piechart"] = load_fragment_shader("piechart.fs");
+    { "vs_piechart", "piechart.vs", true },
+    { "fs_piechart", "piechart.fs", false },
+};
+#endif
+
+void Eng3D::State::reload_shaders() {
+    builtin_shaders.clear();
+#if defined E3D_BACKEND_OPENGL || defined E3D_BACKEND_GLES
+    // Compile built-in shaders
+    for(const auto& builtin : builtin_shader_files) {
+        const auto view = this->package_man.get_unique("shaders/" + std::string(builtin.file_name))->get_view();
+        if(builtin.is_vertex)
+            builtin_shaders[std::string(builtin.name)] = std::make_unique<Eng3D::OpenGL::VertexShader>(view.str());
+        else
+            builtin_shaders[std::string(builtin.name)] = std::make_unique<Eng3D::OpenGL::FragmentShader>(view.str());
+    }
+#endif
+}
+
+/// @brief Recompiles the built-in shaders of a file, the programs using them are relinked
+/// @param file_name The file, relative to the shaders/ directory
+/// @return size_t Number of built-in shaders compiled from the file
+size_t Eng3D::State::reload_shader(const std::string& file_name) {
+    size_t n_reloaded = 0;
+#if defined E3D_BACKEND_OPENGL || defined E3D_BACKEND_GLES
+    for(const auto& builtin : builtin_shader_files) {
+        if(builtin.file_name != file_name) continue;
+        auto it = builtin_shaders.find(std::string(builtin.name));
+        if(it == builtin_shaders.end()) continue;
+        n_reloaded++;
+        try {
+            it->second->reload(this->package_man.get_unique("shaders/" + file_name)->get_view().str());
+        } catch(const Eng3D::ShaderException& e) {
+            Eng3D::Log::error("shader", Eng3D::translate_format("Keeping the previous %s: %s", file_name.c_str(), e.what()));
+        }
+    }
 #endif
+    return n_reloaded;
+}
+
+/// @brief Watches the packages so the resources loaded from files that change while running
+/// get reloaded, see reload_changed_assets
+/// @param enable Whetever to watch the packages
+void Eng3D::State::set_hot_reload(bool enable) {
+    this->package_man.watch(enable);
+}
+
+/// @brief Applies the changes of the packages (when they're watched) and reloads only the
+/// cached resources that were loaded from the files that changed
+void Eng3D::State::reload_changed_assets() {
+    if(this->package_man.watcher.empty()) return;
+    for(const auto& change : this->package_man.update()) {
+        // Nothing could've been loaded from a new path, and what was loaded from a path that
+        // no package provides anymore is kept as-is
+        if(change.prev.get() == nullptr || change.asset.get() == nullptr) continue;
+        // Runs every frame, a file that can't be read must not take the game down
+        try {
+            size_t n_reloaded = 0;
+            // The managers cache by the path resources were loaded from, a packed asset
+            // that was never extracted has no such path so it isn't extracted to find out,
+            // and the new asset is only extracted when there's something to reload
+            const auto prev_path = change.prev->peek_abs_path();
+            if(!prev_path.empty() && (this->tex_man.is_loaded(prev_path) || this->model_man.is_loaded(prev_path))) {
+                const auto new_path = change.asset->get_abs_path();
+                n_reloaded += this->tex_man.reload(prev_path, new_path);
+                n_reloaded += this->model_man.reload(prev_path, new_path);
+            }
+            if(change.path.starts_with("shaders/"))
+                n_reloaded += this->reload_shader(change.path.substr(std::string_view("shaders/").size()));
+            if(n_reloaded)
+                Eng3D::Log::debug("hot_reload", Eng3D::translate_format("Reloading %s", change.path.c_str()));
+        } catch(const std::exception& e) {
+            Eng3D::Log::error("hot_reload", Eng3D::translate_format("Can't reload %s: %s", change.path.c_str(), e.what()));
+        }
+    }
 }
 
 void Eng3D::State::clear() const {
@@ -410,6 +475,7 @@ void Eng3D::State::swap() {
 #else
 
 #endif
+    this->reload_changed_assets();
     tex_man.upload();
 }
 
@@ -541,7 +607,7 @@ void Eng3D::State::handle_mouse_btn(const Eng3D::Event::MouseButton& e) {
                 const std::scoped_lock lock(this->audio_man.sound_lock);
                 auto entries = package_man.get_multiple_prefix("sfx/click");
                 if(!entries.empty()) {
-                    auto audio = this->audio_man.load(entries[rand() % entries.size()]->get_abs_path());
+                    auto audio = this->audio_man.load(entries[rand() % entries.size()]);
                     this->audio_man.sound_queue.push_back(audio);
                 }
                 return;
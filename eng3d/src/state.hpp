@@ -64,6 +64,9 @@ namespace Eng3D {
         void init_window(void);
         void clear() const;
         void reload_shaders();
+        size_t reload_shader(const std::string& file_name);
+        void set_hot_reload(bool enable);
+        void reload_changed_assets();
         void swap();
         void do_event();
         void set_multisamples(int samples) const;
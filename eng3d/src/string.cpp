@@ -26,13 +26,16 @@
 #include <cstring>
 #include <mutex>
 #include <memory>
+#include <algorithm>
+#include <string_view>
 #include "eng3d/string.hpp"
+#include "eng3d/io.hpp"
 
 //
 // StringRef
 //
 Eng3D::StringRef::StringRef(const std::string_view str) {
-    *this = Eng3D::StringManager::get_instance().insert(std::string{str});
+    *this = Eng3D::StringManager::get_instance().insert(str);
 }
 
 const std::string_view Eng3D::StringRef::get_string() const {
@@ -44,12 +47,117 @@ const std::string_view Eng3D::StringRef::get_string() const {
 // StringManager
 //
 static Eng3D::StringManager *g_string_man = nullptr;
+/// @brief String literals registered so far, indexed by their id minus one (the empty
+/// string is id 0). Literals are registered during the static initialization of any
+/// translation unit, so the table is constructed on first use
+struct LiteralTable {
+    /// @brief Ids of strings that aren't literals (interned by a manager before a literal
+    /// was registered onto it) are left empty
+    std::vector<std::string_view> literals;
+    std::unordered_map<std::string_view, size_t> ids;
+    std::mutex mutex;
+};
+static LiteralTable& get_literal_table() {
+    static LiteralTable table;
+    return table;
+}
+
 Eng3D::StringManager::StringManager(Eng3D::State& _s)
     : s{ _s }
 {
+    auto& table = get_literal_table();
+    const std::scoped_lock lock(table.mutex, this->insert_mutex);
+    // So default constructed references are the empty string
+    this->store("");
+    for(const auto& str : table.literals) {
+        // Not a literal, the id is skipped so the literals after it keep theirs
+        if(str.data() == nullptr) this->views.push_back(std::string_view(""));
+        else this->store(str);
+    }
     g_string_man = this;
 }
 
+Eng3D::StringManager::~StringManager() {
+    auto& table = get_literal_table();
+    const std::scoped_lock lock(table.mutex);
+    if(g_string_man == this) g_string_man = nullptr;
+}
+
+/// @brief Registers a string literal, the id it gets is the one the manager gives it
+/// @param str Contents of the literal, must outlive every manager (as literals do)
+/// @return size_t Id of the string
+size_t Eng3D::StringManager::register_literal(const std::string_view str) {
+    if(str.empty()) return 0;
+    auto& table = get_literal_table();
+    const std::scoped_lock lock(table.mutex);
+    // Libraries have their own copy of each literal they use
+    if(auto it = table.ids.find(str); it != table.ids.end()) return it->second;
+    // Registered after the manager was created (i.e from a library loaded at runtime), it
+    // gets the id the manager gives it, and managers created later give it the same one
+    const size_t id = g_string_man != nullptr ? g_string_man->insert(str).get_id() : table.literals.size() + 1;
+    if(table.literals.size() < id) table.literals.resize(id);
+    table.literals[id - 1] = str;
+    table.ids.emplace(str, id);
+    return id;
+}
+
+/// @brief Copies a string onto the storage and gives it an id, the caller must
+/// hold insert_mutex and the string must not be interned already
+size_t Eng3D::StringManager::store(const std::string_view str) {
+    const auto size = str.size() + 1; // Null terminator, so c_str() works
+    if(this->chunk_used + size > chunk_size) {
+        this->chunks.push_back(std::make_unique<char[]>(std::max(size, chunk_size)));
+        this->chunk_used = 0;
+    }
+    auto* data = this->chunks.back().get() + this->chunk_used;
+    std::copy(str.begin(), str.end(), data);
+    data[str.size()] = '\0';
+    // A string that got a chunk of its own leaves the last chunk full
+    this->chunk_used = size > chunk_size ? chunk_size : this->chunk_used + size;
+
+    const std::string_view view(data, str.size());
+    const size_t id = this->views.push_back(view) - this->views.begin();
+    this->ids.emplace(view, id);
+    return id;
+}
+
+/// @brief Interns a string, strings already interned are found without locking
+/// @param str String to intern
+/// @return Eng3D::StringRef Reference to the string, the same for equal strings
+Eng3D::StringRef Eng3D::StringManager::insert(const std::string_view str) {
+    auto it = this->ids.find(str);
+    if(it != this->ids.end()) return Eng3D::StringRef(it->second);
+
+    const std::scoped_lock lock(this->insert_mutex);
+    it = this->ids.find(str); // Another thread may have interned it meanwhile
+    if(it != this->ids.end()) return Eng3D::StringRef(it->second);
+    return Eng3D::StringRef(this->store(str));
+}
+
+/// @brief Interns several strings at once, taking the lock only once for those which
+/// aren't interned yet
+/// @param strs Strings to intern
+/// @return std::vector<Eng3D::StringRef> References to the strings, in the same order
+std::vector<Eng3D::StringRef> Eng3D::StringManager::insert(const std::vector<std::string_view>& strs) {
+    std::vector<Eng3D::StringRef> refs(strs.size());
+    std::vector<size_t> missing;
+    for(size_t i = 0; i < strs.size(); i++) {
+        auto it = this->ids.find(strs[i]);
+        if(it != this->ids.end())
+            refs[i] = Eng3D::StringRef(it->second);
+        else
+            missing.push_back(i);
+    }
+    if(missing.empty()) return refs;
+
+    const std::scoped_lock lock(this->insert_mutex);
+    for(const auto i : missing) {
+        auto it = this->ids.find(strs[i]);
+        refs[i] = Eng3D::StringRef(it != this->ids.end() ? it->second : this->store(strs[i]));
+    }
+    return refs;
+}
+
 Eng3D::StringManager& Eng3D::StringManager::get_instance()
 {
     return *g_string_man;
@@ -57,20 +165,37 @@ Eng3D::StringManager& Eng3D::StringManager::get_instance()
 
 static std::unordered_map<std::string, std::string> trans_msg;
 static std::mutex trans_lock;
+/// @brief Text between the first pair of quotes of a line, if any
+static std::string_view get_quoted(std::string_view line) {
+    const auto start = line.find('"');
+    if(start == std::string_view::npos) return std::string_view();
+    const auto end = line.find('"', start + 1);
+    if(end == std::string_view::npos) return std::string_view();
+    return line.substr(start + 1, end - start - 1);
+}
+
+/// @brief Loads the translations of a .po file, a msgid line followed by a msgstr line
+/// makes a translation
 void Eng3D::Locale::from_file(const std::string& filename) {
-    std::unique_ptr<FILE, decltype(&fclose)> fp(fopen(filename.c_str(), "rt"), fclose);
-    char tmp[100];
-    while(fgets(tmp, sizeof tmp, fp.get()) != nullptr) {
-        if(!strncmp(tmp, "msgid", 5)) {
-            char msgid[100];
-            sscanf(tmp + 5, " %*c%[^\"]s%*c ", msgid);
-            fgets(tmp, sizeof tmp, fp.get());
-            if(!strncmp(tmp, "msgstr", 6)) {
-                char msgstr[100];
-                sscanf(tmp + 6, " %*c%[^\"]s%*c ", msgstr);
-                trans_msg[msgid] = msgstr;
-            }
-        }
+    const Eng3D::IO::MappedFile file(filename);
+    from_text(std::string_view(reinterpret_cast<const char*>(file.data()), file.size()));
+}
+
+void Eng3D::Locale::from_text(std::string_view text) {
+    const auto next_line = [&text]() {
+        const auto end = std::min(text.find('\n'), text.size());
+        const auto line = text.substr(0, end);
+        text.remove_prefix(std::min(end + 1, text.size()));
+        return line;
+    };
+    std::scoped_lock lock(trans_lock);
+    while(!text.empty()) {
+        const auto line = next_line();
+        if(!line.starts_with("msgid")) continue;
+        const auto msgid = get_quoted(line);
+        const auto msgstr_line = next_line();
+        if(!msgid.empty() && msgstr_line.starts_with("msgstr"))
+            trans_msg[std::string(msgid)] = get_quoted(msgstr_line);
     }
 }
 
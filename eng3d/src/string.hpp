@@ -25,12 +25,16 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <cstdint>
 #include <mutex>
 #include <memory>
 #include <iterator>
+#include <algorithm>
 #include <stdexcept>
+#include <tbb/concurrent_vector.h>
+#include <tbb/concurrent_unordered_map.h>
 #include "eng3d/utils.hpp"
 
 namespace Eng3D {
@@ -67,28 +71,70 @@ namespace Eng3D {
     class State;
     /// @brief The string pool manager (singleton), used mainly for translation
     /// purpouses. But also helps to reduce the memory size of various objects.
+    /// Strings are interned, so equal strings share the same id and the storage. The
+    /// storage is append-only chunks which are never moved, so the views given out stay
+    /// valid for the lifetime of the manager, and reads don't take any lock.
     class StringManager {
         Eng3D::State& s;
+        /// @brief Strings are stored on chunks of this size, longer strings get a chunk of their own
+        constexpr static size_t chunk_size = 64 * 1024;
+        std::vector<std::unique_ptr<char[]>> chunks;
+        size_t chunk_used = chunk_size; // Bytes used on the last chunk
+        /// @brief View of each string (including the null terminator past the end), indexed by id
+        tbb::concurrent_vector<std::string_view> views;
+        /// @brief Id of each string, for deduplicating them
+        tbb::concurrent_unordered_map<std::string_view, size_t> ids;
+        std::mutex insert_mutex; // Taken only to store strings that aren't interned yet
+        size_t store(const std::string_view str);
     public:
         StringManager(Eng3D::State& _s);
-        ~StringManager() = default;
-
-        Eng3D::StringRef insert(const std::string& str) {
-            const std::scoped_lock lock(strings_mutex);
-            const auto id = strings.size();
-            std::copy(str.begin(), str.end(), std::back_inserter(strings));
-            strings.push_back('\0');
-            return Eng3D::StringRef(id);
-        }
+        ~StringManager();
+
+        Eng3D::StringRef insert(const std::string_view str);
+        std::vector<Eng3D::StringRef> insert(const std::vector<std::string_view>& strs);
 
+        /// @brief Obtains the string of a reference, wait-free
         const std::string_view get_by_id(const Eng3D::StringRef ref) const {
-            const std::scoped_lock lock(strings_mutex);
-            return &strings[ref.get_id()];
+            return views[ref.get_id()];
+        }
+
+        size_t size() const {
+            return views.size();
         }
 
-        std::vector<char> strings;
+        static size_t register_literal(const std::string_view str);
         static StringManager& get_instance();
-        mutable std::mutex strings_mutex;
+    };
+
+    /// @brief A string literal usable as a template argument
+    template<size_t N>
+    struct FixedString {
+        consteval FixedString(const char (&str)[N]) {
+            std::copy_n(str, N, data);
+        }
+
+        constexpr std::string_view view() const {
+            return std::string_view(data, N - 1);
+        }
+
+        char data[N]{};
+    };
+
+    /// @brief Id of a string literal, each distinct literal is registered once during the
+    /// static initialization and the string manager interns all of them before anything else,
+    /// so the id is known without looking the string up
+    template<Eng3D::FixedString str>
+    struct StringLiteral {
+        static inline const size_t id = Eng3D::StringManager::register_literal(str.view());
+    };
+
+    namespace Literals {
+        /// @brief Reference to a string literal, i.e "province"_sr, doesn't intern anything
+        /// nor allocate. Not to be used from static initializers, the id may not be set yet
+        template<Eng3D::FixedString str>
+        Eng3D::StringRef operator""_sr() {
+            return Eng3D::StringRef(Eng3D::StringLiteral<str>::id);
+        }
     };
 
     /// @brief String formatter
@@ -108,9 +154,11 @@ namespace Eng3D {
     }
 };
 using Eng3D::string_format;
+using Eng3D::Literals::operator""_sr;
 
 namespace Eng3D::Locale {
     void from_file(const std::string& filename);
+    void from_text(std::string_view text);
     std::string translate(const std::string_view str);
 }
 using Eng3D::Locale::translate;
@@ -26,6 +26,7 @@
 #include <algorithm>
 #include <cassert>
 #include <SDL_ttf.h>
+#include <tbb/task_arena.h>
 
 #ifdef E3D_BACKEND_OPENGL
 #   include <GL/glew.h>
@@ -50,7 +51,7 @@ Eng3D::Texture::Texture(const std::string& path)
 }
 
 Eng3D::Texture::Texture(const Eng3D::IO::Asset::Base* asset)
-    : Eng3D::BinaryImage((asset == nullptr) ? "" : asset->abs_path)
+    : Eng3D::BinaryImage((asset == nullptr) ? "" : asset->get_abs_path())
 {
 
 }
@@ -401,9 +402,14 @@ void Eng3D::Texture::gen_mipmaps() const {
 #endif
 }
 
-/// @brief Binds the texture to the current OpenGL context
+/// @brief Binds the texture to the current OpenGL context, managed textures that haven't
+/// been uploaded yet bind the placeholder instead
 void Eng3D::Texture::bind() const {
 #if defined E3D_BACKEND_OPENGL || defined E3D_BACKEND_GLES
+    if(!id && managed) {
+        Eng3D::State::get_instance().tex_man.get_placeholder()->bind();
+        return;
+    }
     glBindTexture(GL_TEXTURE_2D, id);
 #endif
 }
@@ -493,6 +499,8 @@ Eng3D::TextureManager::TextureManager(Eng3D::State& _s)
 
 Eng3D::TextureManager::~TextureManager()
 {
+    // Decoders still running will push requests for textures we're about to destroy
+    this->decode_tasks.wait();
     const std::scoped_lock lock(this->unuploaded_lock);
     // Surfaces have to be properly deallocated before calling SDL_Quit()
     for(auto& request : this->unuploaded_textures) {
@@ -512,6 +520,24 @@ std::shared_ptr<Eng3D::Texture> Eng3D::TextureManager::get_white() {
     return std::shared_ptr<Eng3D::Texture>(white);
 }
 
+/// @brief Transparent texture drawn in place of textures which are still being loaded
+std::shared_ptr<Eng3D::Texture> Eng3D::TextureManager::get_placeholder() {
+    if(placeholder.get() == nullptr) {
+        placeholder = std::make_shared<Eng3D::Texture>(1, 1);
+        placeholder->buffer.get()[0] = 0x00000000;
+        placeholder->upload();
+    }
+    return placeholder;
+}
+
+/// @brief Whetever there are textures being decoded or waiting to be uploaded, loading
+/// screens can use this to know when all requested textures are ready
+bool Eng3D::TextureManager::is_loading() {
+    if(this->decoding_count) return true;
+    const std::scoped_lock lock(this->unuploaded_lock);
+    return !this->unuploaded_textures.empty();
+}
+
 /// @brief Finds a texture in the list of a texture manager if the texture is already in the
 /// list we load the saved texture from the list instead of loading it from the disk. Otherwise
 /// we load it from the disk and add it to the saved texture list. The object returned is a
@@ -524,24 +550,149 @@ std::shared_ptr<Eng3D::Texture> Eng3D::TextureManager::load(const std::string& p
     auto it = textures.find(key);
     if(it != textures.end()) return (*it).second;
 
-    Eng3D::Log::debug("texture", "Loaded and cached texture " + path);
-
     // Otherwise texture is not in our control, so we create a new texture
     std::shared_ptr<Eng3D::Texture> tex;
+    if(options.editable || options.instant_upload) {
+        // The caller wants the pixels right away, so decode them here
+        Eng3D::Log::debug("texture", "Loaded and cached texture " + path);
+        try {
+            tex = std::make_shared<Eng3D::Texture>(path);
+        } catch(const BinaryImageException&) {
+            tex = std::make_shared<Eng3D::Texture>();
+            tex->create_dummy();
+        }
+        tex->managed = true;
+        tex->upload(options);
+        textures[key] = tex;
+        return textures[key];
+    }
+
+    // Only the header is read here so the size is known to the widgets, the pixels are decoded
+    // on a worker and the texture is drawn with the placeholder until it gets uploaded
+    tex = std::make_shared<Eng3D::Texture>();
+    tex->managed = true;
     try {
-        tex = std::make_shared<Eng3D::Texture>(path);
+        tex->read_header(path);
     } catch(const BinaryImageException&) {
-        tex = std::make_shared<Eng3D::Texture>();
         tex->create_dummy();
+        tex->upload(options);
+        textures[key] = tex;
+        return textures[key];
     }
-    tex->managed = true;
-    tex->upload(options);
+
+    this->decode(tex.get(), path, options);
     textures[key] = tex;
     return textures[key];
 }
 
+/// @brief Decodes the image of a texture on a worker and schedules its upload once done, the
+/// decode is enqueued rather than spawned so it makes progress even when no worker is idle.
+/// The texture has to be kept alive by the cache, the manager waits for the decoders
+void Eng3D::TextureManager::decode(Eng3D::Texture* texture, const std::string& path, TextureOptions options) {
+    this->decoding_count++;
+    tbb::this_task_arena::enqueue(this->decode_tasks.defer([this, texture, path, options]() {
+        const auto start_time = std::chrono::steady_clock::now();
+        auto image = std::make_shared<Eng3D::BinaryImage>();
+        try {
+            image->from_file(path);
+        } catch(const BinaryImageException& e) {
+            Eng3D::Log::warning("texture", e.what());
+            image->buffer.reset();
+        }
+        const auto end_time = std::chrono::steady_clock::now();
+        Eng3D::Log::debug("texture", Eng3D::translate_format("Decoded texture %s in %lldms", path.c_str(), static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count())));
+
+        TextureUploadRequest request{};
+        request.texture = texture;
+        request.options = options;
+        request.image = image;
+        {
+            const std::scoped_lock lock(this->unuploaded_lock);
+            this->unuploaded_textures.push_back(request);
+        }
+        this->decoding_count--;
+    }));
+}
+
+/// @brief Reloads the textures that were loaded from a file which changed, they keep their
+/// handles so whoever holds them sees the new contents once they're decoded and uploaded.
+/// Textures shared with other paths (same contents) are left to them instead, and the
+/// path gets a new texture
+/// @param path Path the textures were loaded from
+/// @param new_path Path to load them from now on, differs from path when another file took
+/// over (i.e the mod overriding the file was removed)
+/// @return size_t Number of textures reloaded
+size_t Eng3D::TextureManager::reload(const std::string& path, const std::string& new_path) {
+    std::vector<std::pair<std::string, TextureOptions>> keys;
+    for(const auto& [key, tex] : this->textures)
+        if(key.first == path)
+            keys.push_back(key);
+
+    for(auto key : keys) {
+        auto node = this->textures.extract(key);
+        auto tex = node.mapped();
+        const auto& options = key.second;
+        // Other paths with the same contents share the texture and they didn't change, so
+        // they keep it untouched and this path gets a texture of it's own
+        if(std::any_of(this->textures.begin(), this->textures.end(), [&tex](const auto& e) { return e.second == tex; })) {
+            Eng3D::Log::debug("texture", Eng3D::translate_format("Texture %s is shared with other paths, reloading it onto a new texture", path.c_str()));
+            this->load(new_path, options);
+            continue;
+        }
+        // The contents are going to change, so it's no longer handed out for the ones it had
+        std::erase_if(this->textures_by_content, [&tex](const auto& e) { return e.second == tex; });
+        if(options.editable || options.instant_upload) {
+            try {
+                tex->from_file(new_path);
+            } catch(const BinaryImageException&) {
+                tex->create_dummy();
+            }
+            tex->upload(options);
+        } else {
+            this->decode(tex.get(), new_path, options);
+        }
+        // Keep the old key if a texture was already loaded from the new path
+        node.key().first = new_path;
+        auto result = this->textures.insert(std::move(node));
+        if(!result.inserted) {
+            result.node.key().first = path;
+            this->textures.insert(std::move(result.node));
+        }
+    }
+    return keys.size();
+}
+
+/// @brief Whetever a texture was loaded from the path, with any options
+bool Eng3D::TextureManager::is_loaded(const std::string& path) const {
+    return std::any_of(this->textures.begin(), this->textures.end(), [&path](const auto& e) { return e.first.first == path; });
+}
+
+/// @brief Loads the texture of an asset, an asset with the same contents as one already loaded
+/// (i.e a mod shipping a copy of a base game file) gets the texture of the latter
 std::shared_ptr<Eng3D::Texture> Eng3D::TextureManager::load(std::shared_ptr<Eng3D::IO::Asset::Base> asset, TextureOptions options) {
-    return this->load(asset.get() != nullptr ? asset->get_abs_path() : "", options);
+    if(asset.get() == nullptr) return this->load("", options);
+    const auto path = asset->get_abs_path();
+    // Editable textures are modified by their owner so they're never shared
+    if(!asset->content_hash || options.editable) return this->load(path, options);
+
+    auto key = std::make_pair(path, options);
+    auto it = textures.find(key);
+    if(it != textures.end()) return (*it).second;
+
+    auto content_key = std::make_pair(asset->content_hash, options);
+    auto content_it = textures_by_content.find(content_key);
+    if(content_it != textures_by_content.end()) {
+        auto tex = (*content_it).second;
+        this->n_shared++;
+        this->shared_size += tex->width * tex->height * sizeof(uint32_t);
+        Eng3D::Log::debug("texture", Eng3D::translate_format("Texture %s has the same contents as a loaded one, %zu textures shared saving %.2fMB", path.c_str(), this->n_shared, static_cast<double>(this->shared_size) / (1024.0 * 1024.0)));
+        textures[key] = tex;
+        return tex;
+    }
+
+    auto tex = this->load(path, options);
+    textures_by_content[content_key] = tex;
+    return tex;
 }
 
 std::shared_ptr<Eng3D::Texture> Eng3D::TextureManager::gen_text(Eng3D::TrueType::Font& font, Eng3D::Color color, const std::string& msg) {
@@ -573,17 +724,31 @@ std::shared_ptr<Eng3D::Texture> Eng3D::TextureManager::gen_text(Eng3D::TrueType:
     return text_textures[msg];
 }
 
+/// @brief Uploads the scheduled textures, called once per frame from the render thread, stops
+/// once the upload budget is exhausted so big batches of textures are spread across frames
 void Eng3D::TextureManager::upload() {
-    if(!this->unuploaded_textures.empty()) {
-        const std::scoped_lock lock(this->unuploaded_lock);
-        auto it = this->unuploaded_textures.end() - 1;
-        auto request = *it;
+    const auto start_time = std::chrono::steady_clock::now();
+    const std::scoped_lock lock(this->unuploaded_lock);
+    while(!this->unuploaded_textures.empty()) {
+        auto request = std::move(this->unuploaded_textures.front());
+        this->unuploaded_textures.pop_front();
         if(request.surface != nullptr) {
             request.texture->_upload(request.surface);
             request.surface = nullptr;
         } else {
+            if(request.image.get() != nullptr) {
+                if(request.image->buffer.get() != nullptr) {
+                    request.texture->width = request.image->width;
+                    request.texture->height = request.image->height;
+                    request.texture->buffer = std::move(request.image->buffer);
+                } else {
+                    request.texture->create_dummy();
+                }
+            }
             request.texture->_upload(request.options);
         }
-        this->unuploaded_textures.erase(it);
+
+        if(std::chrono::steady_clock::now() - start_time >= this->upload_budget)
+            break;
     }
 }
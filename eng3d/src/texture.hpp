@@ -36,6 +36,10 @@
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <tbb/task_group.h>
 
 #include "eng3d/ttf.hpp"
 #include "eng3d/binary_image.hpp"
@@ -141,9 +145,10 @@ namespace Eng3D {
         s ^= h(v) + 0x9e3779b9 + (s << 6) + (s >> 2);
     }
 
-    /// @brief Texture map has implementation
+    /// @brief Texture map has implementation, keys are either the path or the hash of the contents
     struct TextureMapHash {
-        inline std::size_t operator()(const std::pair<std::string, TextureOptions>& key) const {
+        template<typename K>
+        inline std::size_t operator()(const std::pair<K, TextureOptions>& key) const {
             std::size_t res = 0;
             hash_combine(res, key.first);
             TextureOptions s = key.second;
@@ -165,6 +170,9 @@ namespace Eng3D {
         Texture* texture;
         TextureOptions options;
         SDL_Surface* surface = nullptr;
+        /// @brief Pixels decoded by a worker, moved into the texture once uploaded
+        /// (an empty buffer means the decode failed)
+        std::shared_ptr<Eng3D::BinaryImage> image;
     };
 
     /// @brief General manager for textures, caches textures into the memory instead of reading them off the disk
@@ -172,13 +180,22 @@ namespace Eng3D {
     class TextureManager {
     private:
         std::unordered_map<std::pair<std::string, TextureOptions>, std::shared_ptr<Eng3D::Texture>, TextureMapHash> textures;
-        std::vector<TextureUploadRequest> unuploaded_textures; // Textures that needs to be uploaded
+        /// @brief Textures by the hash of the file they were loaded from, assets with the same
+        /// contents share the decoded pixels and the GPU texture
+        std::unordered_map<std::pair<uint64_t, TextureOptions>, std::shared_ptr<Eng3D::Texture>, TextureMapHash> textures_by_content;
+        size_t n_shared = 0;
+        size_t shared_size = 0;
+        std::deque<TextureUploadRequest> unuploaded_textures; // Textures that needs to be uploaded
         std::mutex unuploaded_lock;
+        tbb::task_group decode_tasks; // Textures being read and decoded on workers
+        std::atomic<size_t> decoding_count = 0;
         std::shared_ptr<Eng3D::Texture> white;
+        std::shared_ptr<Eng3D::Texture> placeholder;
         /// @brief Stores the text textures
         /// @todo Take in account colour and font for creating the key, since repeated text will be displayed incorrectly
         std::unordered_map<std::string, std::shared_ptr<Eng3D::Texture>> text_textures;
         Eng3D::State& s;
+        void decode(Eng3D::Texture* texture, const std::string& path, TextureOptions options);
     public:
         TextureManager() = delete;
         TextureManager(Eng3D::State& s);
@@ -186,9 +203,17 @@ namespace Eng3D {
         std::shared_ptr<Eng3D::Texture> load(const std::string& path, TextureOptions options = default_options);
         std::shared_ptr<Eng3D::Texture> load(std::shared_ptr<Eng3D::IO::Asset::Base> asset, TextureOptions options = default_options);
         std::shared_ptr<Eng3D::Texture> gen_text(Eng3D::TrueType::Font& font, Eng3D::Color color, const std::string& msg);
+        size_t reload(const std::string& path, const std::string& new_path);
+        bool is_loaded(const std::string& path) const;
         std::shared_ptr<Eng3D::Texture> get_white();
+        std::shared_ptr<Eng3D::Texture> get_placeholder();
+        bool is_loading();
         void upload();
 
+        /// @brief Time spent each frame uploading textures to the GPU, at least one
+        /// texture is uploaded per frame regardless
+        std::chrono::microseconds upload_budget{ 4000 };
+
         friend class Eng3D::Texture;
     };
 };
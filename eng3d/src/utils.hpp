@@ -31,6 +31,7 @@
 #   include <concepts>
 #   include <iomanip>
 #   include <algorithm>
+#   include <array>
 namespace std {
 #if !defined(__cpp_lib_bit_cast)
     template <class To, class From>
@@ -0,0 +1,1165 @@
+// Eng3D - General purpouse game engine
+// Copyright (C) 2021, Eng3D contributors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+// Name:
+//      archive.cpp
+//
+// Abstract:
+//      Benchmark and regression suite for the serializer, (de)-serializes
+//      representative payloads and checks that they round-trip correctly.
+//      Run with --json for machine-readable output and --quick for a short
+//      run (used by ctest).
+// ----------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include <bitset>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <algorithm>
+#include <bit>
+#include <filesystem>
+#include <thread>
+#include "eng3d/serializer.hpp"
+#include "eng3d/chunk_store.hpp"
+#include "eng3d/pak.hpp"
+#include "eng3d/entity.hpp"
+#include "eng3d/compress.hpp"
+#include "eng3d/codec.hpp"
+
+//
+// Allocation counting
+//
+static std::atomic<size_t> n_allocs = 0;
+
+// None of these are inlined, otherwise GCC sees malloc()/free() paired with the operators
+// on the other side and warns about mismatched allocations
+[[gnu::noinline]] void* operator new(std::size_t size) {
+    n_allocs++;
+    if(size == 0) size++;
+    void* p = std::malloc(size);
+    if(p) return p;
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void* operator new[](std::size_t size) {
+    n_allocs++;
+    if(size == 0) size++;
+    void* p = std::malloc(size);
+    if(p) return p;
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+//
+// Payloads
+//
+struct TestNation : RefnameEntity<uint16_t> {
+    uint32_t budget = 0;
+    std::vector<uint16_t> relations;
+};
+template<>
+struct Serializer<TestNation> {
+    template<bool is_const>
+    using type = CondConstType<is_const, TestNation>::type;
+
+    template<bool is_serialize>
+    static inline void deser_dynamic(Archive& ar, type<is_serialize>& obj) {
+        ::deser_dynamic<is_serialize>(ar, obj.cached_id);
+        ::deser_dynamic<is_serialize>(ar, obj.budget);
+        ::deser_dynamic<is_serialize>(ar, obj.relations);
+    }
+};
+
+struct TestProvince : Entity<uint32_t> {
+    TestNation* owner = nullptr;
+    TestNation* controller = nullptr;
+    float population = 0.f;
+    std::vector<uint32_t> neighbours;
+};
+template<>
+struct Serializer<TestProvince> {
+    template<bool is_const>
+    using type = CondConstType<is_const, TestProvince>::type;
+
+    template<bool is_serialize>
+    static inline void deser_dynamic(Archive& ar, type<is_serialize>& obj) {
+        ::deser_dynamic<is_serialize>(ar, obj.cached_id);
+        ::deser_dynamic<is_serialize>(ar, obj.owner);
+        ::deser_dynamic<is_serialize>(ar, obj.controller);
+        ::deser_dynamic<is_serialize>(ar, obj.population);
+        ::deser_dynamic<is_serialize>(ar, obj.neighbours);
+    }
+};
+
+struct TestWorld {
+    std::vector<TestNation> nations;
+    std::vector<TestProvince> provinces;
+};
+template<>
+struct Serializer<TestWorld> {
+    template<bool is_const>
+    using type = CondConstType<is_const, TestWorld>::type;
+
+    template<bool is_serialize>
+    static inline void deser_dynamic(Archive& ar, type<is_serialize>& obj) {
+        ::deser_dynamic<is_serialize>(ar, obj.nations);
+        ::deser_dynamic<is_serialize>(ar, obj.provinces);
+        if constexpr(!is_serialize) {
+            ar.register_entities(obj.nations);
+            ar.resolve_entities();
+        }
+    }
+};
+
+static bool operator==(const TestWorld& a, const TestWorld& b) {
+    if(a.nations.size() != b.nations.size() || a.provinces.size() != b.provinces.size())
+        return false;
+    for(size_t i = 0; i < a.nations.size(); i++)
+        if(a.nations[i].cached_id != b.nations[i].cached_id || a.nations[i].budget != b.nations[i].budget || a.nations[i].relations != b.nations[i].relations)
+            return false;
+    for(size_t i = 0; i < a.provinces.size(); i++) {
+        const auto& pa = a.provinces[i];
+        const auto& pb = b.provinces[i];
+        const auto id_of = [](const TestNation* n) { return n ? static_cast<int>(n->cached_id) : -1; };
+        if(pa.cached_id != pb.cached_id || id_of(pa.owner) != id_of(pb.owner) || id_of(pa.controller) != id_of(pb.controller)
+        || pa.population != pb.population || pa.neighbours != pb.neighbours)
+            return false;
+    }
+    return true;
+}
+
+/// @brief Trivially copyable, but the pointer must still go through it's serializer
+struct TestHolder {
+    TestNation* nation = nullptr;
+    uint32_t amount = 0;
+};
+template<>
+struct Serializer<TestHolder> {
+    template<bool is_const>
+    using type = CondConstType<is_const, TestHolder>::type;
+
+    template<bool is_serialize>
+    static inline void deser_dynamic(Archive& ar, type<is_serialize>& obj) {
+        ::deser_dynamic<is_serialize>(ar, obj.nation);
+        ::deser_dynamic<is_serialize>(ar, obj.amount);
+    }
+};
+
+/// @brief Entity pointers inside of trivially copyable types and node containers
+struct TestLinks {
+    std::vector<TestNation> nations;
+    std::vector<TestHolder> holders;
+    std::map<uint32_t, TestNation*> by_key;
+    std::map<TestNation*, uint32_t> keyed_by_nation;
+    std::set<TestNation*> set;
+    std::unordered_set<TestNation*> hash_set;
+    std::unordered_map<uint32_t, std::vector<TestNation*>> lists;
+};
+template<>
+struct Serializer<TestLinks> {
+    template<bool is_const>
+    using type = CondConstType<is_const, TestLinks>::type;
+
+    template<bool is_serialize>
+    static inline void deser_dynamic(Archive& ar, type<is_serialize>& obj) {
+        ::deser_dynamic<is_serialize>(ar, obj.nations);
+        if constexpr(!is_serialize)
+            ar.register_entities(obj.nations);
+        ::deser_dynamic<is_serialize>(ar, obj.holders);
+        ::deser_dynamic<is_serialize>(ar, obj.by_key);
+        ::deser_dynamic<is_serialize>(ar, obj.keyed_by_nation);
+        ::deser_dynamic<is_serialize>(ar, obj.set);
+        ::deser_dynamic<is_serialize>(ar, obj.hash_set);
+        ::deser_dynamic<is_serialize>(ar, obj.lists);
+        if constexpr(!is_serialize)
+            ar.resolve_entities();
+    }
+};
+
+/// @brief Compares by the ids of the entities pointed to, a pointer into the wrong list
+/// (or a raw address from the other side) never matches
+static bool operator==(const TestLinks& a, const TestLinks& b) {
+    const auto id_of = [](const TestLinks& links, const TestNation* n) -> int {
+        if(n == nullptr) return -1;
+        if(links.nations.empty() || n < links.nations.data() || n >= links.nations.data() + links.nations.size()) return -2;
+        return static_cast<int>(n->cached_id);
+    };
+    const auto ids_of = [&](const TestLinks& links, const auto& nations) {
+        std::vector<int> ids;
+        for(const auto* n : nations) ids.push_back(id_of(links, n));
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+    if(a.nations.size() != b.nations.size() || a.holders.size() != b.holders.size() || a.by_key.size() != b.by_key.size()
+    || a.keyed_by_nation.size() != b.keyed_by_nation.size() || a.lists.size() != b.lists.size())
+        return false;
+    for(size_t i = 0; i < a.holders.size(); i++)
+        if(id_of(a, a.holders[i].nation) != id_of(b, b.holders[i].nation) || a.holders[i].amount != b.holders[i].amount)
+            return false;
+    for(const auto& [key, nation] : a.by_key)
+        if(!b.by_key.contains(key) || id_of(a, nation) != id_of(b, b.by_key.at(key)))
+            return false;
+    std::map<int, uint32_t> keyed_a, keyed_b;
+    for(const auto& [nation, value] : a.keyed_by_nation) keyed_a[id_of(a, nation)] = value;
+    for(const auto& [nation, value] : b.keyed_by_nation) keyed_b[id_of(b, nation)] = value;
+    for(const auto& [key, list] : a.lists)
+        if(!b.lists.contains(key) || ids_of(a, list) != ids_of(b, b.lists.at(key)))
+            return false;
+    return keyed_a == keyed_b && ids_of(a, a.set) == ids_of(b, b.set) && ids_of(a, a.hash_set) == ids_of(b, b.hash_set);
+}
+
+static TestLinks make_links(std::mt19937& rng, size_t n_nations, size_t n_links) {
+    TestLinks links;
+    links.nations.resize(n_nations);
+    for(size_t i = 0; i < n_nations; i++)
+        links.nations[i].cached_id = i;
+    const auto random_nation = [&]() -> TestNation* {
+        return (rng() % 8) ? &links.nations[rng() % n_nations] : nullptr;
+    };
+    links.holders.resize(n_links);
+    for(auto& holder : links.holders) {
+        holder.nation = random_nation();
+        holder.amount = rng();
+    }
+    for(size_t i = 0; i < n_links; i++) {
+        links.by_key[rng()] = random_nation();
+        links.keyed_by_nation[random_nation()] = rng();
+        links.set.insert(random_nation());
+        links.hash_set.insert(random_nation());
+        links.lists[rng() % 64].push_back(random_nation());
+    }
+    return links;
+}
+
+/// @brief Pointers held by sets and maps can't be resolved afterwards, so deserializing
+/// them without their entities registered first must fail rather than write through
+/// dangling addresses
+static bool check_unregistered_entities(const TestLinks& links) {
+    Archive ar{};
+    ::serialize(ar, links.nations);
+    ::serialize(ar, links.set);
+    ar.rewind();
+    std::vector<TestNation> nations;
+    std::set<TestNation*> set;
+    ::deserialize(ar, nations);
+    try {
+        ::deserialize(ar, set);
+    } catch(const SerializerException&) {
+        return true;
+    }
+    return false;
+}
+
+/// @brief Trivially copyable, but the id of the string only means something to this process
+struct TestLabel {
+    Eng3D::StringRef title;
+    uint32_t value = 0;
+};
+template<>
+struct Serializer<TestLabel> {
+    template<bool is_const>
+    using type = CondConstType<is_const, TestLabel>::type;
+
+    template<bool is_serialize>
+    static inline void deser_dynamic(Archive& ar, type<is_serialize>& obj) {
+        ::deser_dynamic<is_serialize>(ar, obj.title);
+        ::deser_dynamic<is_serialize>(ar, obj.value);
+    }
+};
+
+static bool operator==(const TestLabel& a, const TestLabel& b) {
+    return a.title.id == b.title.id && a.value == b.value;
+}
+
+static std::vector<TestLabel> make_labels() {
+    std::vector<TestLabel> labels;
+    for(uint32_t i = 0; i < 1000; i++)
+        labels.push_back(TestLabel{ Eng3D::StringRef(i % 3 ? "label_" + std::to_string(i % 7) : std::string()), i });
+    labels.push_back(TestLabel{ Eng3D::StringRef(Archive::invalid_string_id), 0 });
+    return labels;
+}
+
+/// @brief Types holding string references go through their serializer, and an in-memory
+/// archive only decodes when the string table is sent along with it
+static bool check_string_refs() {
+    static_assert(std::is_trivially_copyable_v<TestLabel> && !serializer_is_memcpy<TestLabel>);
+    const auto labels = make_labels();
+
+    Archive sent{};
+    ::serialize(sent, labels);
+    Archive bare{};
+    bare.set_buffer(sent.get_buffer(), sent.size());
+    sent.write_string_table();
+    try {
+        std::vector<TestLabel> result;
+        ::deserialize(bare, result);
+        return false;
+    } catch(const SerializerException&) {
+        // Expected, the table wasn't sent
+    }
+
+    Archive received{};
+    received.set_buffer(sent.get_buffer(), sent.size());
+    received.read_string_table();
+    std::vector<TestLabel> result;
+    ::deserialize(received, result);
+    return result == labels && received.ptr == received.size();
+}
+
+/// @brief The string managers don't touch the state
+static Eng3D::State& get_dummy_state() {
+    alignas(std::max_align_t) static char state_storage[64];
+    return *reinterpret_cast<Eng3D::State*>(state_storage);
+}
+
+/// @brief String literals have the id the manager gives to the same text, be it
+/// registered before the manager existed or after it (i.e by a library loaded later)
+static bool check_literals() {
+    auto& string_man = Eng3D::StringManager::get_instance();
+    bool ok = "archive_literal"_sr == string_man.insert("archive_literal");
+    ok = ok && ""_sr == Eng3D::StringRef() && "label_3"_sr == Eng3D::StringRef("label_3");
+    string_man.insert("archive_not_a_literal"); // So the ids of the manager and the literal table differ
+    const auto late_id = Eng3D::StringManager::register_literal("archive_late_literal");
+    ok = ok && late_id == string_man.insert("archive_late_literal").get_id();
+    const auto interned = string_man.insert("archive_interned_literal");
+    ok = ok && Eng3D::StringManager::register_literal("archive_interned_literal") == interned.get_id();
+    return ok;
+}
+
+/// @brief A literal registered while a manager exists keeps its id on the managers created
+/// afterwards, and a destroyed manager isn't used anymore. Leaves no current manager, so
+/// it runs last
+static bool check_later_managers() {
+    auto& first = Eng3D::StringManager::get_instance();
+    first.insert("archive_string_before_literal");
+    const auto id = Eng3D::StringManager::register_literal("archive_runtime_literal");
+    auto second = std::make_unique<Eng3D::StringManager>(get_dummy_state());
+    bool ok = second->insert("archive_runtime_literal").get_id() == id;
+    ok = ok && second->insert("archive_literal").get_id() == first.insert("archive_literal").get_id();
+    ok = ok && Eng3D::StringManager::register_literal("archive_runtime_literal") == id;
+    second.reset();
+    return ok && Eng3D::StringManager::register_literal("archive_literal_without_manager") != 0;
+}
+
+static TestWorld make_world(std::mt19937& rng, size_t n_nations, size_t n_provinces) {
+    TestWorld world;
+    world.nations.resize(n_nations);
+    for(size_t i = 0; i < n_nations; i++) {
+        world.nations[i].cached_id = i;
+        world.nations[i].budget = rng() % 100000;
+        world.nations[i].relations.resize(n_nations);
+        for(auto& relation : world.nations[i].relations)
+            relation = rng() % 200;
+    }
+    world.provinces.resize(n_provinces);
+    for(size_t i = 0; i < n_provinces; i++) {
+        auto& province = world.provinces[i];
+        province.cached_id = i;
+        province.owner = (rng() % 8) ? &world.nations[rng() % n_nations] : nullptr;
+        province.controller = province.owner;
+        province.population = static_cast<float>(rng() % 1000000) * 0.25f;
+        province.neighbours.resize(2 + rng() % 6);
+        for(auto& neighbour : province.neighbours)
+            neighbour = rng() % n_provinces;
+    }
+    return world;
+}
+
+//
+// Benchmarking
+//
+struct BenchResult {
+    std::string name;
+    size_t bytes = 0;
+    double ser_mbps = 0.f;
+    double deser_mbps = 0.f;
+    double ser_allocs = 0.f;
+    double deser_allocs = 0.f;
+    size_t packed_bytes = 0; // Compressed size, if the benchmark compresses
+    bool ok = true;
+};
+
+static bool json_output = false;
+static int iterations = 10;
+static int failures = 0;
+
+static void report(const BenchResult& r) {
+    if(!r.ok) failures++;
+    if(json_output) {
+        std::printf("{\"name\":\"%s\",\"bytes\":%zu,\"packed_bytes\":%zu,\"ser_mbps\":%.2f,\"deser_mbps\":%.2f,\"ser_allocs\":%.2f,\"deser_allocs\":%.2f,\"ok\":%s}\n",
+            r.name.c_str(), r.bytes, r.packed_bytes, r.ser_mbps, r.deser_mbps, r.ser_allocs, r.deser_allocs, r.ok ? "true" : "false");
+    } else {
+        std::printf("%-32s %10zu B %10.2f MB/s %10.2f MB/s %10.2f %10.2f ",
+            r.name.c_str(), r.bytes, r.ser_mbps, r.deser_mbps, r.ser_allocs, r.deser_allocs);
+        if(r.packed_bytes)
+            std::printf("%9.2fx ", static_cast<double>(r.bytes) / r.packed_bytes);
+        else
+            std::printf("%10s ", "-");
+        std::printf("%s\n", r.ok ? "" : "MISMATCH");
+    }
+}
+
+static double to_mbps(size_t bytes, std::chrono::steady_clock::duration d) {
+    const double secs = std::chrono::duration<double>(d).count();
+    return secs > 0.f ? (static_cast<double>(bytes) / (1024.f * 1024.f)) / secs : 0.f;
+}
+
+/// @brief Serializes and deserializes the payload through an in-memory archive
+template<typename T>
+static BenchResult bench_memory(const std::string& name, const T& payload, std::function<void(Archive&)> setup = nullptr) {
+    BenchResult r{};
+    r.name = name;
+    std::chrono::steady_clock::duration ser_time{}, deser_time{};
+    size_t ser_allocs = 0, deser_allocs = 0;
+    for(int i = 0; i < iterations; i++) {
+        Archive ar{};
+        if(setup) setup(ar);
+        auto allocs = n_allocs.load();
+        auto start = std::chrono::steady_clock::now();
+        ::serialize(ar, payload);
+        ser_time += std::chrono::steady_clock::now() - start;
+        ser_allocs += n_allocs.load() - allocs;
+        r.bytes = ar.size();
+
+        T result{};
+        ar.rewind();
+        allocs = n_allocs.load();
+        start = std::chrono::steady_clock::now();
+        ::deserialize(ar, result);
+        deser_time += std::chrono::steady_clock::now() - start;
+        deser_allocs += n_allocs.load() - allocs;
+        r.ok = r.ok && (result == payload) && ar.ptr == ar.size();
+    }
+    r.ser_mbps = to_mbps(r.bytes * iterations, ser_time);
+    r.deser_mbps = to_mbps(r.bytes * iterations, deser_time);
+    r.ser_allocs = static_cast<double>(ser_allocs) / iterations;
+    r.deser_allocs = static_cast<double>(deser_allocs) / iterations;
+    return r;
+}
+
+/// @brief Serializes the payload and writes it to a file (with compression), then reads
+/// and deserializes it back, throughput is relative to the uncompressed size
+template<typename T>
+static BenchResult bench_file(const std::string& name, const T& payload, std::function<void(Archive&)> setup = nullptr) {
+    BenchResult r{};
+    r.name = name;
+    const std::string path = "archive_bench.sav";
+    std::chrono::steady_clock::duration ser_time{}, deser_time{};
+    size_t ser_allocs = 0, deser_allocs = 0;
+    for(int i = 0; i < iterations; i++) {
+        auto allocs = n_allocs.load();
+        auto start = std::chrono::steady_clock::now();
+        {
+            Archive ar{};
+            if(setup) setup(ar);
+            ::serialize(ar, payload);
+            r.bytes = ar.size();
+            ar.to_file(path);
+        }
+        r.packed_bytes = std::filesystem::file_size(path);
+        ser_time += std::chrono::steady_clock::now() - start;
+        ser_allocs += n_allocs.load() - allocs;
+
+        T result{};
+        allocs = n_allocs.load();
+        start = std::chrono::steady_clock::now();
+        {
+            Archive ar{};
+            ar.from_file(path);
+            ::deserialize(ar, result);
+        }
+        deser_time += std::chrono::steady_clock::now() - start;
+        deser_allocs += n_allocs.load() - allocs;
+        r.ok = r.ok && (result == payload);
+    }
+    std::remove(path.c_str());
+    r.ser_mbps = to_mbps(r.bytes * iterations, ser_time);
+    r.deser_mbps = to_mbps(r.bytes * iterations, deser_time);
+    r.ser_allocs = static_cast<double>(ser_allocs) / iterations;
+    r.deser_allocs = static_cast<double>(deser_allocs) / iterations;
+    return r;
+}
+
+/// @brief Compresses and decompresses many small messages (like network packets) with
+/// reusable zlib streams, optionally with a preset dictionary
+template<typename T>
+static BenchResult bench_messages(const std::string& name, const std::vector<T>& messages, const std::vector<uint8_t>& dictionary = {}) {
+    BenchResult r{};
+    r.name = name;
+    std::chrono::steady_clock::duration ser_time{}, deser_time{};
+    size_t ser_allocs = 0, deser_allocs = 0;
+    std::vector<std::vector<uint8_t>> compressed(messages.size());
+    std::vector<typename T::value_type> result;
+    Eng3D::Zlib::Deflate deflate{};
+    Eng3D::Zlib::Inflate inflate{};
+    if(!dictionary.empty()) {
+        deflate.set_dictionary(dictionary.data(), dictionary.size());
+        inflate.set_dictionary(dictionary.data(), dictionary.size());
+    }
+    for(int i = 0; i < iterations; i++) {
+        r.bytes = r.packed_bytes = 0;
+        auto allocs = n_allocs.load();
+        auto start = std::chrono::steady_clock::now();
+        for(size_t j = 0; j < messages.size(); j++) {
+            compressed[j].resize(deflate.bound(messages[j].size()));
+            compressed[j].resize(deflate.compress(messages[j].data(), messages[j].size(), compressed[j].data(), compressed[j].size()));
+            r.bytes += messages[j].size();
+            r.packed_bytes += compressed[j].size();
+        }
+        ser_time += std::chrono::steady_clock::now() - start;
+        ser_allocs += n_allocs.load() - allocs;
+
+        allocs = n_allocs.load();
+        start = std::chrono::steady_clock::now();
+        for(size_t j = 0; j < messages.size(); j++) {
+            result.resize(messages[j].size());
+            const auto size = inflate.decompress(compressed[j].data(), compressed[j].size(), result.data(), result.size());
+            r.ok = r.ok && size == messages[j].size() && std::equal(result.begin(), result.end(), messages[j].begin());
+        }
+        deser_time += std::chrono::steady_clock::now() - start;
+        deser_allocs += n_allocs.load() - allocs;
+    }
+    r.ser_mbps = to_mbps(r.bytes * iterations, ser_time);
+    r.deser_mbps = to_mbps(r.bytes * iterations, deser_time);
+    r.ser_allocs = static_cast<double>(ser_allocs) / iterations;
+    r.deser_allocs = static_cast<double>(deser_allocs) / iterations;
+    return r;
+}
+
+/// @brief Archives using the non-native byte order, so the swapping paths are also
+/// exercised on little-endian hosts
+static void set_swapped(Archive& ar) {
+    ar.byte_order = std::endian::native == std::endian::little ? std::endian::big : std::endian::little;
+}
+
+/// @brief Checks that a swapped bulk array holds the exact same bytes as the native
+/// encoding with every element reversed
+template<typename T>
+static bool check_byte_order(const std::vector<T>& values) {
+    Archive native{}, swapped{};
+    set_swapped(swapped);
+    ::serialize(native, values);
+    ::serialize(swapped, values);
+    if(native.size() != swapped.size()) return false;
+    const size_t header = sizeof(uint32_t); // Element count
+    if(!std::equal(native.buffer.begin(), native.buffer.begin() + header, swapped.buffer.rbegin() + (swapped.size() - header)))
+        return false;
+    for(size_t i = header; i < native.size(); i += sizeof(T))
+        if(!std::equal(native.buffer.begin() + i, native.buffer.begin() + i + sizeof(T), swapped.buffer.rbegin() + (swapped.size() - i - sizeof(T))))
+            return false;
+    return true;
+}
+
+/// @brief Flips one byte of a saved archive (on the table of contents and on the
+/// payload) and checks that loading it fails instead of yielding garbage
+static bool check_corruption(const std::vector<uint32_t>& values) {
+    const std::string path = "archive_corrupt.sav";
+    Archive ar{};
+    ::serialize(ar, values);
+    ar.to_file(path);
+    std::vector<char> data;
+    if(auto* fp = std::fopen(path.c_str(), "rb"); fp != nullptr) {
+        std::fseek(fp, 0, SEEK_END);
+        data.resize(std::ftell(fp));
+        std::fseek(fp, 0, SEEK_SET);
+        data.resize(std::fread(data.data(), 1, data.size(), fp));
+        std::fclose(fp);
+    }
+    bool ok = data.size() > 64;
+    for(const size_t offset : { size_t(12), data.size() / 2, data.size() - 1 }) {
+        if(!ok) break;
+        auto corrupted = data;
+        corrupted[offset] ^= 0x10;
+        if(auto* fp = std::fopen(path.c_str(), "wb"); fp != nullptr) {
+            std::fwrite(corrupted.data(), 1, corrupted.size(), fp);
+            std::fclose(fp);
+        }
+        try {
+            Archive loaded{};
+            loaded.from_file(path);
+            ok = false;
+        } catch(const std::exception&) {
+            // Expected
+        }
+    }
+    std::remove(path.c_str());
+
+    // Equal states must hash equal, any change must be noticed
+    Archive a{}, b{};
+    ::serialize(a, values);
+    ::serialize(b, values);
+    ok = ok && a.checksum() == b.checksum();
+    b.buffer[b.size() / 2] ^= 1;
+    return ok && a.checksum() != b.checksum();
+}
+
+/// @brief A save that fails (here the destination is a directory, so it can't be replaced)
+/// must throw and not leave the temporary file behind
+static bool check_failed_save(const std::vector<uint32_t>& values) {
+    const std::string path = "archive_failed.sav";
+    std::filesystem::create_directory(path);
+    Archive ar{};
+    ::serialize(ar, values);
+    bool ok = false;
+    try {
+        ar.to_file(path);
+    } catch(const std::exception&) {
+        ok = true;
+    }
+    ok = ok && !std::filesystem::exists(path + ".tmp") && ar.size() > 0;
+    std::filesystem::remove_all(path);
+    return ok;
+}
+
+/// @brief Incremental saves onto a chunk store: concurrent saves sharing chunks, reuse of
+/// chunks across saves, loading, pruning, and chunks left empty by a crash
+static bool check_chunk_store(const std::vector<uint32_t>& values) {
+    const std::string dir = "archive_chunks";
+    std::filesystem::remove_all(dir);
+    auto changed = values;
+    changed[changed.size() / 2] ^= 1;
+    Archive a{}, b{};
+    ::serialize(a, values);
+    ::serialize(b, changed);
+    const auto matches = [](ArchiveChunkStore& store, const std::string& manifest_path, const std::vector<uint32_t>& expected) {
+        Archive ar{};
+        store.load(ar, manifest_path);
+        std::vector<uint32_t> result;
+        ::deserialize(ar, result);
+        return result == expected && ar.ptr == ar.size();
+    };
+
+    bool ok = true;
+    try {
+        ArchiveChunkStore store(dir);
+        // Both saves write the chunks they share at the same time
+        std::thread other([&]() { store.save(a, dir + "/a.sav"); });
+        store.save(b, dir + "/b.sav");
+        other.join();
+        store.save(b, dir + "/b.sav");
+        ok = ok && store.last_new_chunks == 0 && store.last_reused_chunks > 0;
+        ok = ok && matches(store, dir + "/a.sav", values) && matches(store, dir + "/b.sav", changed);
+        // The chunk that only the first save has is removed
+        store.prune({ dir + "/b.sav" });
+        ok = ok && matches(store, dir + "/b.sav", changed);
+        try {
+            ok = ok && !matches(store, dir + "/a.sav", values);
+        } catch(const std::exception&) {
+            // Expected
+        }
+
+        // A chunk that was never fully written isn't reused by later saves
+        for(const auto& entry : std::filesystem::recursive_directory_iterator(dir)) {
+            ok = ok && entry.path().extension() != ".tmp";
+            if(entry.path().extension() == ".chunk") {
+                std::filesystem::resize_file(entry.path(), 0);
+                break;
+            }
+        }
+        ArchiveChunkStore reopened(dir);
+        reopened.save(b, dir + "/c.sav");
+        ok = ok && reopened.last_new_chunks == 1 && matches(reopened, dir + "/c.sav", changed);
+    } catch(const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        ok = false;
+    }
+    std::filesystem::remove_all(dir);
+    return ok;
+}
+
+/// @brief Saves on the background thread, the archive is left empty right away and the
+/// callback runs once the file is in place
+static bool check_async_save(const std::vector<uint32_t>& values) {
+    const std::string path = "archive_async.sav";
+    Archive ar{};
+    ::serialize(ar, values);
+    std::atomic<bool> called = false;
+    auto task = ar.to_file_async(path, [&called](const ArchiveSaveTask& t) {
+        called = t.status == ArchiveSaveTask::Status::DONE;
+    });
+    bool ok = ar.size() == 0;
+    task->wait();
+    ok = ok && task->is_done() && task->status == ArchiveSaveTask::Status::DONE && called && task->progress == 1.f;
+    try {
+        Archive loaded{};
+        loaded.from_file(path);
+        std::vector<uint32_t> result;
+        ::deserialize(loaded, result);
+        ok = ok && result == values && loaded.ptr == loaded.size();
+    } catch(const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        ok = false;
+    }
+    std::remove(path.c_str());
+    return ok;
+}
+
+/// @brief Writes several sections (one with a string table) and loads them back one by
+/// one and all at once, only the requested sections may be decompressed
+static bool check_sections(const std::vector<uint32_t>& values, const TestWorld& world) {
+    const std::string path = "archive_sections.sav";
+    const auto labels = make_labels();
+    SectionedArchive sar{};
+    ::serialize(sar.add_section("scalars"), values);
+    ::serialize(sar.add_section("world"), world);
+    ::serialize(sar.add_section("labels"), labels);
+    bool ok = true;
+    try {
+        sar.to_file(path);
+
+        SectionedArchive lazy{};
+        lazy.open(path);
+        ok = ok && lazy.sections.size() == 3 && lazy.find_section("missing") == nullptr;
+        ok = ok && std::none_of(lazy.sections.begin(), lazy.sections.end(), [](const auto& section) { return section.loaded; });
+        std::vector<TestLabel> label_result;
+        ::deserialize(lazy.load_section("labels"), label_result);
+        ok = ok && label_result == labels && lazy.find_section("labels")->has_string_table;
+        ok = ok && !lazy.find_section("scalars")->loaded && !lazy.find_section("world")->loaded;
+        std::vector<uint32_t> scalar_result;
+        ::deserialize(lazy.load_section("scalars"), scalar_result);
+        ok = ok && scalar_result == values && !lazy.find_section("world")->loaded;
+
+        SectionedArchive all{};
+        all.open(path);
+        all.load_all();
+        ok = ok && std::all_of(all.sections.begin(), all.sections.end(), [](const auto& section) { return section.loaded; });
+        TestWorld world_result;
+        ::deserialize(all.find_section("world")->archive, world_result);
+        scalar_result.clear();
+        ::deserialize(all.find_section("scalars")->archive, scalar_result);
+        label_result.clear();
+        ::deserialize(all.find_section("labels")->archive, label_result);
+        ok = ok && world_result == world && scalar_result == values && label_result == labels;
+    } catch(const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        ok = false;
+    }
+    std::remove(path.c_str());
+    return ok;
+}
+
+/// @brief Quantized floats take float_bits bits each, are within half a step of the
+/// original value, and saturate instead of wrapping around when out of range
+static bool check_quantized() {
+    std::mt19937 rng(4321);
+    bool ok = true;
+    for(const unsigned bits : { 8U, 16U, 32U }) {
+        Archive ar{};
+        ar.float_mode = Archive::FloatMode::QUANTIZED;
+        ar.float_scale = 10.f;
+        ar.float_bits = bits;
+        const auto max = static_cast<int64_t>((uint64_t(1) << (bits - 1)) - 1);
+        const float range = std::min(static_cast<float>(max) / ar.float_scale, 1000.f);
+        std::vector<float> values(4096);
+        for(auto& e : values)
+            e = (static_cast<float>(rng()) / static_cast<float>(std::mt19937::max()) * 2.f - 1.f) * range;
+        values.push_back(static_cast<float>(max) * 2.f / ar.float_scale);
+        values.push_back(static_cast<float>(max) * -2.f / ar.float_scale);
+        ::serialize(ar, values);
+        ok = ok && ar.size() == sizeof(uint32_t) + values.size() * (bits / 8);
+
+        ar.rewind();
+        std::vector<float> result;
+        ::deserialize(ar, result);
+        ok = ok && result.size() == values.size() && ar.ptr == ar.size();
+        if(!ok) break;
+        for(size_t i = 0; i < values.size() - 2; i++)
+            ok = ok && std::abs(result[i] - values[i]) <= 0.5f / ar.float_scale + std::abs(values[i]) * 1e-6f;
+        ok = ok && result[values.size() - 2] == static_cast<float>(max) / ar.float_scale;
+        ok = ok && result[values.size() - 1] == static_cast<float>(-max - 1) / ar.float_scale;
+    }
+    return ok;
+}
+
+/// @brief A boolean vector claiming more bits than the archive holds is rejected before
+/// anything is allocated
+static bool check_bool_vector_length() {
+    Archive ar{};
+    const uint32_t len = std::numeric_limits<uint32_t>::max();
+    ::serialize(ar, len);
+    ::serialize(ar, uint64_t(0));
+    ar.rewind();
+    std::vector<bool> flags;
+    try {
+        ::deserialize(ar, flags);
+    } catch(const SerializerException&) {
+        return flags.capacity() == 0;
+    }
+    return false;
+}
+
+/// @brief Round-trips buffers through every codec, and checks that truncated or damaged
+/// LZ streams are rejected (or at least never written past the output)
+static bool check_codecs(std::mt19937& rng) {
+    using Eng3D::Compression::Codec;
+    std::vector<std::vector<uint8_t>> inputs(6);
+    inputs[1] = { 'a' };
+    inputs[2].assign(100000, 'x'); // Overlapping matches
+    inputs[3].resize(100000); // Incompressible
+    for(auto& c : inputs[3]) c = rng();
+    inputs[4].resize(100000); // Short repeats
+    for(auto& c : inputs[4]) c = "abcdefgh"[rng() % (1 + rng() % 8)];
+    for(size_t i = 0; i < 300000; i++) // Long repeats, far away from each other
+        inputs[5].push_back(static_cast<uint8_t>((i % 70001) * 7 + (i / 70001)));
+
+    bool ok = true;
+    for(const auto codec : { Codec::NONE, Codec::ZLIB, Codec::LZ }) {
+        for(const auto& input : inputs) {
+            std::vector<uint8_t> packed(Eng3D::Compression::compress_bound(codec, input.size()));
+            packed.resize(Eng3D::Compression::compress({ codec, 1 }, input.data(), input.size(), packed.data(), packed.size()));
+            std::vector<uint8_t> output(input.size());
+            try {
+                const auto r = Eng3D::Compression::decompress(codec, packed.data(), packed.size(), output.data(), output.size());
+                ok = ok && r == input.size() && output == input;
+            } catch(const std::exception&) {
+                ok = false;
+            }
+            if(codec != Codec::LZ || packed.size() < 2) continue;
+
+            for(const size_t len : { packed.size() / 2, packed.size() - 1 }) {
+                std::vector<uint8_t> damaged(packed.begin(), packed.begin() + len);
+                damaged[len / 2] ^= 0x5a;
+                std::vector<uint8_t> guarded(output.size() + 16, 0xee);
+                try {
+                    const auto r = Eng3D::Lz::decompress(damaged.data(), damaged.size(), guarded.data(), output.size());
+                    ok = ok && r <= output.size();
+                } catch(const std::exception&) {
+                    // Expected
+                }
+                ok = ok && std::all_of(guarded.end() - 16, guarded.end(), [](auto c) { return c == 0xee; });
+            }
+        }
+    }
+    return ok;
+}
+
+static std::vector<uint8_t> read_whole_file(const std::string& path) {
+    std::vector<uint8_t> data;
+    if(auto* fp = std::fopen(path.c_str(), "rb"); fp != nullptr) {
+        std::fseek(fp, 0, SEEK_END);
+        data.resize(std::ftell(fp));
+        std::fseek(fp, 0, SEEK_SET);
+        data.resize(std::fread(data.data(), 1, data.size(), fp));
+        std::fclose(fp);
+    }
+    return data;
+}
+
+static void write_whole_file(const std::string& path, const std::vector<uint8_t>& data) {
+    if(auto* fp = std::fopen(path.c_str(), "wb"); fp != nullptr) {
+        if(!data.empty()) std::fwrite(data.data(), 1, data.size(), fp);
+        std::fclose(fp);
+    }
+}
+
+/// @brief Packs a directory and reads every entry back (directly, through a view and
+/// extracted onto the cache), then checks that damaged or truncated packs are rejected
+static bool check_pak(std::mt19937& rng) {
+    const std::string dir = "archive_pak_src", pak_path = "archive_test.pak";
+    std::map<std::string, std::vector<uint8_t>> files;
+    files["text.txt"].assign(100000, 'x'); // Compressed
+    auto& noise = files["sub/noise.bin"]; // Stored, it doesn't shrink
+    noise.resize(50000);
+    for(auto& c : noise) c = rng();
+    files["sub/deeper/empty"] = {};
+    files["small.txt"] = { 'h', 'i' };
+    std::filesystem::remove_all(dir);
+    for(const auto& [path, data] : files) {
+        std::filesystem::create_directories(std::filesystem::path(dir + "/" + path).parent_path());
+        write_whole_file(dir + "/" + path, data);
+    }
+
+    bool ok = true;
+    try {
+        Eng3D::IO::pack_directory(dir, pak_path, Eng3D::Compression::Settings(Eng3D::Compression::Codec::ZLIB));
+        ok = ok && !std::filesystem::exists(pak_path + ".tmp");
+        auto pak = std::make_shared<const Eng3D::IO::PakFile>(pak_path);
+        ok = ok && pak->entries.size() == files.size() && pak->find("missing") == nullptr;
+        for(const auto& [path, data] : files) {
+            const auto* entry = pak->find(path);
+            if(entry == nullptr) return false;
+            ok = ok && pak->read(*entry) == data && entry->inf_size == data.size();
+            Eng3D::IO::Asset::Packed asset(pak, *entry);
+            const auto view = asset.get_view();
+            ok = ok && std::equal(view.data().begin(), view.data().end(), data.begin(), data.end());
+        }
+        ok = ok && pak->find("text.txt")->codec == Eng3D::Compression::Codec::ZLIB && pak->find("text.txt")->size < 1000;
+        ok = ok && pak->find("sub/noise.bin")->codec == Eng3D::Compression::Codec::NONE;
+
+        // Extracted for the libraries that need a path, leaving nothing else behind
+        Eng3D::IO::Asset::Packed asset(pak, *pak->find("small.txt"));
+        const std::filesystem::path extracted = asset.get_abs_path();
+        ok = ok && asset.get_abs_path() == extracted.string() && read_whole_file(extracted.string()) == files["small.txt"];
+        ok = ok && std::distance(std::filesystem::directory_iterator(extracted.parent_path()), std::filesystem::directory_iterator{}) == 1;
+        std::filesystem::remove_all(extracted.parent_path());
+        std::error_code ec; // Only removed when empty, they may be in use
+        std::filesystem::remove(extracted.parent_path().parent_path(), ec);
+        std::filesystem::remove(extracted.parent_path().parent_path().parent_path(), ec);
+    } catch(const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        ok = false;
+    }
+
+    // The header is little endian on every host
+    const auto data = read_whole_file(pak_path);
+    ok = ok && data.size() > 64 && data[4] == 2 && data[5] == 0;
+    const auto rejects = [&](std::vector<uint8_t> damaged, bool on_read) {
+        write_whole_file(pak_path, damaged);
+        try {
+            Eng3D::IO::PakFile pak(pak_path);
+            if(!on_read) return false;
+            for(const auto& entry : pak.entries)
+                pak.read(entry);
+            return false;
+        } catch(const std::exception&) {
+            return true;
+        }
+    };
+    auto damaged = data;
+    damaged[20] ^= 0x10; // Index
+    ok = ok && rejects(damaged, false);
+    damaged = data;
+    damaged[data.size() - 1] ^= 0x10; // Contents of the last entry
+    ok = ok && rejects(damaged, true);
+    ok = ok && rejects(std::vector<uint8_t>(data.begin(), data.begin() + 24), false);
+    ok = ok && rejects(std::vector<uint8_t>(data.begin(), data.begin() + data.size() / 2), false);
+    std::remove(pak_path.c_str());
+    std::filesystem::remove_all(dir);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    bool quick = false;
+    for(int i = 1; i < argc; i++) {
+        if(!std::strcmp(argv[i], "--json")) json_output = true;
+        else if(!std::strcmp(argv[i], "--quick")) quick = true;
+    }
+    if(quick) iterations = 2;
+    const size_t scale = quick ? 1 : 16;
+    const auto varint = [](Archive& ar) { ar.int_mode = Archive::IntMode::VARINT; };
+
+    if(!json_output)
+        std::printf("%-32s %12s %15s %15s %10s %10s %10s\n", "name", "size", "serialize", "deserialize", "allocs", "allocs", "ratio");
+
+    Eng3D::StringManager string_man(get_dummy_state());
+
+    std::mt19937 rng(1234);
+    std::vector<uint32_t> scalars(65536 * scale);
+    for(auto& e : scalars) e = rng() % 4096;
+    report(bench_memory("scalars", scalars));
+    report(bench_memory("scalars/varint", scalars, varint));
+    report(bench_memory("scalars/swapped", scalars, set_swapped));
+
+    std::vector<float> floats(65536 * scale);
+    for(auto& e : floats) e = static_cast<float>(rng()) / 1000.f;
+    report(bench_memory("floats", floats));
+    report(bench_memory("floats/swapped", floats, set_swapped));
+    if(!check_quantized()) {
+        std::fprintf(stderr, "quantized floats out of tolerance\n");
+        failures++;
+    }
+
+    std::vector<uint16_t> shorts(65536 * scale);
+    for(auto& e : shorts) e = rng();
+    std::vector<double> doubles(65536 * scale);
+    for(auto& e : doubles) e = static_cast<double>(rng()) / 3.0;
+    if(!check_byte_order(scalars) || !check_byte_order(shorts) || !check_byte_order(floats) || !check_byte_order(doubles)) {
+        std::fprintf(stderr, "swapped arrays don't match the reversed native encoding\n");
+        failures++;
+    }
+    if(!check_corruption(scalars)) {
+        std::fprintf(stderr, "corrupted archives weren't detected\n");
+        failures++;
+    }
+    if(!check_failed_save(scalars)) {
+        std::fprintf(stderr, "failed saves left files behind\n");
+        failures++;
+    }
+    if(!check_chunk_store(scalars)) {
+        std::fprintf(stderr, "chunk store failed to round-trip\n");
+        failures++;
+    }
+    if(!check_async_save(scalars)) {
+        std::fprintf(stderr, "asynchronous save didn't round-trip\n");
+        failures++;
+    }
+    if(!check_codecs(rng)) {
+        std::fprintf(stderr, "codecs failed to round-trip\n");
+        failures++;
+    }
+    if(!check_pak(rng)) {
+        std::fprintf(stderr, "packed archive failed to round-trip\n");
+        failures++;
+    }
+
+    std::vector<std::vector<int32_t>> nested(4096 * scale);
+    for(auto& v : nested) {
+        v.resize(rng() % 32);
+        for(auto& e : v) e = static_cast<int32_t>(rng() % 2000) - 1000;
+    }
+    report(bench_memory("nested", nested));
+    report(bench_memory("nested/varint", nested, varint));
+    report(bench_memory("nested/swapped", nested, set_swapped));
+
+    std::vector<std::string> strings(8192 * scale);
+    for(auto& str : strings) {
+        str.resize(4 + rng() % 28);
+        for(auto& c : str) c = 'a' + rng() % 26;
+    }
+    report(bench_memory("strings", strings));
+
+    std::vector<std::bitset<64>> bitsets(16384 * scale);
+    for(auto& bits : bitsets) bits = std::bitset<64>(rng());
+    report(bench_memory("bitsets", bitsets));
+
+    std::vector<std::bitset<4099>> masks(64 * scale);
+    for(auto& mask : masks)
+        for(size_t i = 0; i < mask.size(); i++) mask[i] = rng() & 1;
+    report(bench_memory("wide bitsets", masks));
+
+    std::vector<bool> flags(262144 * scale + 13);
+    for(size_t i = 0; i < flags.size(); i++) flags[i] = rng() & 1;
+    report(bench_memory("bool vector", flags));
+    report(bench_memory("bool vectors", std::vector<std::vector<bool>>{ {}, { true }, std::vector<bool>(64, true), std::vector<bool>(65, true) }));
+    if(!check_bool_vector_length()) {
+        std::fprintf(stderr, "bool vector longer than the archive was accepted\n");
+        failures++;
+    }
+
+    std::vector<std::pair<uint32_t, std::string>> pairs(8192 * scale);
+    for(auto& [key, value] : pairs) {
+        key = rng();
+        value = std::to_string(rng());
+    }
+    report(bench_memory("pairs", pairs));
+
+    std::map<uint32_t, std::string> map;
+    std::unordered_map<uint32_t, std::string> hash_map;
+    std::unordered_set<uint64_t> hash_set;
+    for(const auto& [key, value] : pairs) {
+        map.emplace(key, value);
+        hash_map.emplace(key, value);
+        hash_set.insert((static_cast<uint64_t>(key) << 32) | rng());
+    }
+    report(bench_memory("map", map));
+    report(bench_memory("unordered map", hash_map));
+    report(bench_memory("unordered set", hash_set));
+
+    const auto links = make_links(rng, 256, 1024 * scale);
+    report(bench_memory("entity links", links));
+    report(bench_memory("entity links/varint", links, varint));
+    if(!check_unregistered_entities(links)) {
+        std::fprintf(stderr, "pointers in sets were deserialized without their entities\n");
+        failures++;
+    }
+
+    if(!check_literals()) {
+        std::fprintf(stderr, "string literals don't match the interned strings\n");
+        failures++;
+    }
+    if(!check_string_refs()) {
+        std::fprintf(stderr, "string references didn't round-trip through the string table\n");
+        failures++;
+    }
+
+    const auto world = make_world(rng, 256, 8192 * scale);
+    report(bench_memory("entities", world));
+    report(bench_memory("entities/varint", world, varint));
+    if(!check_sections(scalars, world)) {
+        std::fprintf(stderr, "sectioned archive didn't round-trip\n");
+        failures++;
+    }
+    report(bench_file("entities/file", world));
+    report(bench_file("entities/file/varint", world, varint));
+    for(const auto preset : { Eng3D::Compression::Preset::AUTOSAVE, Eng3D::Compression::Preset::MANUAL_SAVE, Eng3D::Compression::Preset::NETWORK }) {
+        const Eng3D::Compression::Settings settings(preset);
+        std::string name = std::string("entities/file/") + Eng3D::Compression::get_name(settings.codec);
+        if(settings.codec == Eng3D::Compression::Codec::ZLIB)
+            name += std::to_string(settings.level);
+        report(bench_file(name, world, [settings](Archive& ar) {
+            ar.compression = settings;
+        }));
+    }
+    report(bench_file("entities/file/none", world, [](Archive& ar) {
+        ar.compression.codec = Eng3D::Compression::Codec::NONE;
+    }));
+    report(bench_file("scalars/file", scalars));
+    report(bench_file("scalars/file/swapped", scalars, set_swapped));
+
+    std::vector<std::string> messages(1024 * scale);
+    for(auto& message : messages) {
+        message.resize(64 + rng() % 448);
+        for(auto& c : message) c = "0123456789 province nation"[rng() % 26];
+    }
+    report(bench_messages("zlib/messages", messages));
+
+    // Small records, like the property updates sent over the network, with and without
+    // a dictionary trained on other records
+    constexpr const char* properties[] = { "owner", "controller", "population", "budget", "culture", "religion", "terrain", "units" };
+    constexpr const char* names[] = { "aragon", "castile", "leon", "navarra", "portugal", "granada", "sicily", "naples", "milan", "venice" };
+    std::vector<std::vector<uint8_t>> records(2048 * scale);
+    for(auto& record : records) {
+        std::vector<std::pair<std::string, uint32_t>> updates(4 + rng() % 8);
+        for(auto& [key, value] : updates) {
+            key = std::string(properties[rng() % std::size(properties)]) + "." + names[rng() % std::size(names)];
+            value = rng() % 1000;
+        }
+        Archive ar{};
+        ::serialize(ar, updates);
+        record = std::move(ar.buffer);
+    }
+    const std::vector<std::vector<uint8_t>> training(records.begin(), records.begin() + records.size() / 2);
+    const std::vector<std::vector<uint8_t>> samples(records.begin() + records.size() / 2, records.end());
+    const auto dictionary = Eng3D::Zlib::train_dictionary(training);
+    report(bench_messages("zlib/records", samples));
+    report(bench_messages("zlib/records/dictionary", samples, dictionary));
+
+    if(!check_later_managers()) {
+        std::fprintf(stderr, "string literals changed their id on a new manager\n");
+        failures++;
+    }
+
+    if(failures)
+        std::fprintf(stderr, "%d benchmarks failed to round-trip\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
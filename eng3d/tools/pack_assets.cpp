@@ -0,0 +1,83 @@
+// Eng3D - General purpouse game engine
+// Copyright (C) 2021, Eng3D contributors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+// Name:
+//      pack_assets.cpp
+//
+// Abstract:
+//      Packs the directory of a package onto a packed archive, which the
+//      package manager picks up when placed next to (or instead of) the
+//      directory.
+// ----------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <exception>
+#include "eng3d/pak.hpp"
+
+static void usage(const char* name) {
+    std::fprintf(stderr, "Usage: %s [--codec none|zlib|lz] [--level n] input_dir output.pak\n", name);
+    std::fprintf(stderr, "Files which don't shrink by at least 10%% are stored uncompressed\n");
+}
+
+int main(int argc, char** argv) {
+    Eng3D::Compression::Settings settings(Eng3D::Compression::Codec::LZ);
+    std::string input, output;
+    for(int i = 1; i < argc; i++) {
+        if(!std::strcmp(argv[i], "--codec") && i + 1 < argc) {
+            const char* codec = argv[++i];
+            if(!std::strcmp(codec, "none")) settings.codec = Eng3D::Compression::Codec::NONE;
+            else if(!std::strcmp(codec, "zlib")) settings.codec = Eng3D::Compression::Codec::ZLIB;
+            else if(!std::strcmp(codec, "lz")) settings.codec = Eng3D::Compression::Codec::LZ;
+            else {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if(!std::strcmp(argv[i], "--level") && i + 1 < argc) {
+            settings.level = std::atoi(argv[++i]);
+        } else if(input.empty()) {
+            input = argv[i];
+        } else if(output.empty()) {
+            output = argv[i];
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(input.empty() || output.empty()) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    try {
+        Eng3D::IO::pack_directory(input, output, settings);
+        const Eng3D::IO::PakFile pak(output);
+        size_t inf_size = 0, size = 0, n_compressed = 0;
+        for(const auto& entry : pak.entries) {
+            inf_size += entry.inf_size;
+            size += entry.size;
+            n_compressed += entry.codec != Eng3D::Compression::Codec::NONE;
+        }
+        std::printf("%zu files (%zu compressed), %zu bytes -> %zu bytes\n", pak.entries.size(), n_compressed, inf_size, size);
+    } catch(const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
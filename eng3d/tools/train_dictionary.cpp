@@ -0,0 +1,117 @@
+// Eng3D - General purpouse game engine
+// Copyright (C) 2021, Eng3D contributors
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+// Name:
+//      train_dictionary.cpp
+//
+// Abstract:
+//      Trains a preset zlib dictionary out of archives or raw payloads, the
+//      dictionary is then shipped as an asset and given to the zlib streams.
+// ----------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <exception>
+#include <memory>
+#include <algorithm>
+#include "eng3d/serializer.hpp"
+#include "eng3d/compress.hpp"
+
+static std::vector<uint8_t> read_file(const std::string& path) {
+    std::vector<uint8_t> data;
+    std::unique_ptr<FILE, decltype(&std::fclose)> fp(std::fopen(path.c_str(), "rb"), std::fclose);
+    if(fp == nullptr) return data;
+    uint8_t buf[4096];
+    size_t n;
+    while((n = std::fread(buf, 1, sizeof(buf), fp.get())) > 0)
+        data.insert(data.end(), buf, buf + n);
+    return data;
+}
+
+/// @brief Splits a payload onto samples of at most sample_size bytes, so a big save
+/// resembles the small records the dictionary is meant for
+static void add_samples(std::vector<std::vector<uint8_t>>& samples, const std::vector<uint8_t>& data, size_t sample_size) {
+    for(size_t offset = 0; offset < data.size(); offset += sample_size) {
+        const auto end = std::min(offset + sample_size, data.size());
+        samples.emplace_back(data.begin() + offset, data.begin() + end);
+    }
+}
+
+static void usage(const char* name) {
+    std::fprintf(stderr, "Usage: %s [--size bytes] [--sample-size bytes] output.dict input...\n", name);
+    std::fprintf(stderr, "Inputs are archives (every section is sampled) or raw payloads\n");
+}
+
+int main(int argc, char** argv) {
+    size_t dict_size = Eng3D::Zlib::default_dictionary_size;
+    size_t sample_size = 1024;
+    std::vector<std::string> paths;
+    for(int i = 1; i < argc; i++) {
+        if(!std::strcmp(argv[i], "--size") && i + 1 < argc) dict_size = std::strtoul(argv[++i], nullptr, 10);
+        else if(!std::strcmp(argv[i], "--sample-size") && i + 1 < argc) sample_size = std::strtoul(argv[++i], nullptr, 10);
+        else paths.push_back(argv[i]);
+    }
+    if(paths.size() < 2 || !sample_size) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::vector<uint8_t>> samples;
+    size_t total = 0;
+    for(size_t i = 1; i < paths.size(); i++) {
+        try {
+            SectionedArchive sar{};
+            sar.open(paths[i]);
+            sar.load_all();
+            for(const auto& section : sar.sections)
+                add_samples(samples, section.archive.buffer, sample_size);
+        } catch(const std::exception&) {
+            add_samples(samples, read_file(paths[i]), sample_size);
+        }
+    }
+    for(const auto& sample : samples)
+        total += sample.size();
+    if(samples.empty()) {
+        std::fprintf(stderr, "No samples were read\n");
+        return EXIT_FAILURE;
+    }
+
+    const auto dictionary = Eng3D::Zlib::train_dictionary(samples, dict_size);
+    std::unique_ptr<FILE, decltype(&std::fclose)> fp(std::fopen(paths[0].c_str(), "wb"), std::fclose);
+    if(fp == nullptr || std::fwrite(dictionary.data(), 1, dictionary.size(), fp.get()) != dictionary.size()) {
+        std::fprintf(stderr, "Can't write %s\n", paths[0].c_str());
+        return EXIT_FAILURE;
+    }
+
+    // How much the dictionary helps on the samples themselves
+    Eng3D::Zlib::Deflate plain{}, trained{};
+    trained.set_dictionary(dictionary.data(), dictionary.size());
+    size_t plain_size = 0, trained_size = 0;
+    std::vector<uint8_t> dest;
+    for(const auto& sample : samples) {
+        dest.resize(plain.bound(sample.size()));
+        plain_size += plain.compress(sample.data(), sample.size(), dest.data(), dest.size());
+        dest.resize(trained.bound(sample.size()));
+        trained_size += trained.compress(sample.data(), sample.size(), dest.data(), dest.size());
+    }
+    std::printf("%zu samples, %zu bytes -> %zu byte dictionary\n", samples.size(), total, dictionary.size());
+    std::printf("compressed: %zu bytes without dictionary, %zu bytes with it\n", plain_size, trained_size);
+    return EXIT_SUCCESS;
+}